@@ -77,6 +77,7 @@
 #define ZRANGER_TASK_PRI        2
 #define ZRANGER2_TASK_PRI       2
 #define LOG_TASK_PRI            1
+#define LOG_SCHEDULER_TASK_PRI  2
 #define MEM_TASK_PRI            1
 #define PARAM_TASK_PRI          1
 #define PROXIMITY_TASK_PRI      0
@@ -87,6 +88,7 @@
 #define CMD_HIGH_LEVEL_TASK_PRI 2
 #define INA219_TASK_PRI         3
 #define INA260_TASK_PRI         3
+#define I2C_BUS_TASK_PRI        3
 
 #define SYSLINK_TASK_PRI        3
 #define USBLINK_TASK_PRI        3
@@ -106,6 +108,7 @@
 #define CRTP_RX_TASK_NAME       "CRTP-RX"
 #define CRTP_RXTX_TASK_NAME     "CRTP-RXTX"
 #define LOG_TASK_NAME           "LOG"
+#define LOG_SCHEDULER_TASK_NAME "LOGSCHED"
 #define MEM_TASK_NAME           "MEM"
 #define PARAM_TASK_NAME         "PARAM"
 #define SENSORS_TASK_NAME       "SENSORS"
@@ -127,6 +130,7 @@
 #define MULTIRANGER_TASK_NAME   "MR"
 #define INA219_TASK_NAME        "INA219"
 #define INA260_TASK_NAME        "INA260"
+#define I2C_BUS_TASK_NAME       "I2C"
 
 //Task stack sizes
 #define SYSTEM_TASK_STACKSIZE         (2* configMINIMAL_STACK_SIZE)
@@ -136,6 +140,7 @@
 #define CRTP_RX_TASK_STACKSIZE        (2* configMINIMAL_STACK_SIZE)
 #define CRTP_RXTX_TASK_STACKSIZE      configMINIMAL_STACK_SIZE
 #define LOG_TASK_STACKSIZE            configMINIMAL_STACK_SIZE
+#define LOG_SCHEDULER_TASK_STACKSIZE  (2 * configMINIMAL_STACK_SIZE)
 #define MEM_TASK_STACKSIZE            (2 * configMINIMAL_STACK_SIZE)
 #define PARAM_TASK_STACKSIZE          configMINIMAL_STACK_SIZE
 #define SENSORS_TASK_STACKSIZE        (2 * configMINIMAL_STACK_SIZE)
@@ -157,6 +162,7 @@
 #define MULTIRANGER_TASK_STACKSIZE    (2 * configMINIMAL_STACK_SIZE)
 #define INA219_TASK_STACKSIZE         configMINIMAL_STACK_SIZE
 #define INA260_TASK_STACKSIZE         configMINIMAL_STACK_SIZE
+#define I2C_BUS_TASK_STACKSIZE        configMINIMAL_STACK_SIZE
 
 //The radio channel. From 0 to 125
 #define RADIO_CHANNEL 80
@@ -82,10 +82,17 @@
 
 static bool isInit = false;
 
-static SemaphoreHandle_t txComplete;
-static SemaphoreHandle_t rxComplete;
+static SemaphoreHandle_t transferComplete;
 static SemaphoreHandle_t spiMutex;
 
+// Segments of the ongoing transfer, only touched by the DMA interrupt while it runs
+static const spiSegment_t* volatile currentSegment;
+static volatile size_t segmentsLeft;
+
+// Source and sink for segments without tx or rx buffer
+static uint8_t fillByte = 0x00;
+static uint8_t discardByte;
+
 static void spiDMAInit();
 static void spiConfigureWithSpeed(uint16_t baudRatePrescaler);
 
@@ -95,8 +102,7 @@ void spiBegin(void)
 
   // binary semaphores created using xSemaphoreCreateBinary() are created in a state
   // such that the the semaphore must first be 'given' before it can be 'taken'
-  txComplete = xSemaphoreCreateBinary();
-  rxComplete = xSemaphoreCreateBinary();
+  transferComplete = xSemaphoreCreateBinary();
   spiMutex = xSemaphoreCreateMutex();
 
   /*!< Enable the SPI clock */
@@ -183,9 +189,8 @@ static void spiDMAInit()
   NVIC_InitStructure.NVIC_IRQChannelSubPriority = 0;
   NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
 
-  NVIC_InitStructure.NVIC_IRQChannel = SPI_TX_DMA_IRQ;
-  NVIC_Init(&NVIC_InitStructure);
-
+  // The rx stream is always the last one to complete, so the transfer is
+  // driven by its interrupt only
   NVIC_InitStructure.NVIC_IRQChannel = SPI_RX_DMA_IRQ;
   NVIC_Init(&NVIC_InitStructure);
 }
@@ -219,26 +224,55 @@ bool spiTest(void)
   return isInit;
 }
 
-bool spiExchange(size_t length, const uint8_t * data_tx, uint8_t * data_rx)
+static void spiStartSegment(const spiSegment_t* segment)
 {
-  // DMA already configured, just need to set memory addresses
-  SPI_TX_DMA_STREAM->M0AR = (uint32_t)data_tx;
-  SPI_TX_DMA_STREAM->NDTR = length;
-
-  SPI_RX_DMA_STREAM->M0AR = (uint32_t)data_rx;
-  SPI_RX_DMA_STREAM->NDTR = length;
-
-  // Enable SPI DMA Interrupts
-  DMA_ITConfig(SPI_TX_DMA_STREAM, DMA_IT_TC, ENABLE);
-  DMA_ITConfig(SPI_RX_DMA_STREAM, DMA_IT_TC, ENABLE);
+  // The streams are disabled by hardware at the end of the previous segment, the
+  // memory address and increment can be changed without stopping them first
+  if (segment->tx) {
+    SPI_TX_DMA_STREAM->M0AR = (uint32_t)segment->tx;
+    SPI_TX_DMA_STREAM->CR |= DMA_SxCR_MINC;
+  } else {
+    SPI_TX_DMA_STREAM->M0AR = (uint32_t)&fillByte;
+    SPI_TX_DMA_STREAM->CR &= ~DMA_SxCR_MINC;
+  }
+  SPI_TX_DMA_STREAM->NDTR = segment->length;
+
+  if (segment->rx) {
+    SPI_RX_DMA_STREAM->M0AR = (uint32_t)segment->rx;
+    SPI_RX_DMA_STREAM->CR |= DMA_SxCR_MINC;
+  } else {
+    SPI_RX_DMA_STREAM->M0AR = (uint32_t)&discardByte;
+    SPI_RX_DMA_STREAM->CR &= ~DMA_SxCR_MINC;
+  }
+  SPI_RX_DMA_STREAM->NDTR = segment->length;
 
   // Clear DMA Flags
   DMA_ClearFlag(SPI_TX_DMA_STREAM, DMA_FLAG_FEIF5|DMA_FLAG_DMEIF5|DMA_FLAG_TEIF5|DMA_FLAG_HTIF5|DMA_FLAG_TCIF5);
   DMA_ClearFlag(SPI_RX_DMA_STREAM, DMA_FLAG_FEIF0|DMA_FLAG_DMEIF0|DMA_FLAG_TEIF0|DMA_FLAG_HTIF0|DMA_FLAG_TCIF0);
 
-  // Enable DMA Streams
-  DMA_Cmd(SPI_TX_DMA_STREAM,ENABLE);
+  // Enable DMA Streams, rx first so that no received byte is missed
   DMA_Cmd(SPI_RX_DMA_STREAM,ENABLE);
+  DMA_Cmd(SPI_TX_DMA_STREAM,ENABLE);
+}
+
+bool spiExchangeSegments(const spiSegment_t *segments, size_t nbrOfSegments)
+{
+  // Skip empty segments, the DMA can not transfer 0 bytes
+  while (nbrOfSegments > 0 && segments->length == 0) {
+    segments++;
+    nbrOfSegments--;
+  }
+  if (nbrOfSegments == 0) {
+    return true;
+  }
+
+  currentSegment = segments;
+  segmentsLeft = nbrOfSegments;
+
+  // Enable SPI DMA Interrupts
+  DMA_ITConfig(SPI_RX_DMA_STREAM, DMA_IT_TC, ENABLE);
+
+  spiStartSegment(segments);
 
   // Enable SPI DMA requests
   SPI_I2S_DMACmd(SPI, SPI_I2S_DMAReq_Tx, ENABLE);
@@ -248,14 +282,19 @@ bool spiExchange(size_t length, const uint8_t * data_tx, uint8_t * data_rx)
   SPI_Cmd(SPI, ENABLE);
 
   // Wait for completion
-  bool result = (xSemaphoreTake(txComplete, portMAX_DELAY) == pdTRUE)
-             && (xSemaphoreTake(rxComplete, portMAX_DELAY) == pdTRUE);
+  bool result = (xSemaphoreTake(transferComplete, portMAX_DELAY) == pdTRUE);
 
   // Disable peripheral
   SPI_Cmd(SPI, DISABLE);
   return result;
 }
 
+bool spiExchange(size_t length, const uint8_t * data_tx, uint8_t * data_rx)
+{
+  const spiSegment_t segment = {length, data_tx, data_rx};
+  return spiExchangeSegments(&segment, 1);
+}
+
 void spiBeginTransaction(uint16_t baudRatePrescaler)
 {
   xSemaphoreTake(spiMutex, portMAX_DELAY);
@@ -267,51 +306,41 @@ void spiEndTransaction()
   xSemaphoreGive(spiMutex);
 }
 
-void __attribute__((used)) SPI_TX_DMA_IRQHandler(void)
+void __attribute__((used)) SPI_RX_DMA_IRQHandler(void)
 {
   portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
 
-  // Stop and cleanup DMA stream
-  DMA_ITConfig(SPI_TX_DMA_STREAM, DMA_IT_TC, DISABLE);
-  DMA_ClearITPendingBit(SPI_TX_DMA_STREAM, SPI_TX_DMA_FLAG_TCIF);
+  DMA_ClearITPendingBit(SPI_RX_DMA_STREAM, SPI_RX_DMA_FLAG_TCIF);
 
   // Clear stream flags
-  DMA_ClearFlag(SPI_TX_DMA_STREAM,SPI_TX_DMA_FLAG_TCIF);
-
-  // Disable SPI DMA requests
-  SPI_I2S_DMACmd(SPI, SPI_I2S_DMAReq_Tx, DISABLE);
-
-  // Disable streams
-  DMA_Cmd(SPI_TX_DMA_STREAM,DISABLE);
-
-  // Give the semaphore, allowing the SPI transaction to complete
-  xSemaphoreGiveFromISR(txComplete, &xHigherPriorityTaskWoken);
+  DMA_ClearFlag(SPI_RX_DMA_STREAM,SPI_RX_DMA_FLAG_TCIF);
 
-  if (xHigherPriorityTaskWoken)
-  {
-    portYIELD();
+  // Continue with the next segment without waking up the task. All bytes of
+  // the segment have been received, so the tx stream is done as well.
+  segmentsLeft--;
+  while (segmentsLeft > 0 && (currentSegment + 1)->length == 0) {
+    currentSegment++;
+    segmentsLeft--;
+  }
+  if (segmentsLeft > 0) {
+    currentSegment++;
+    spiStartSegment(currentSegment);
+    return;
   }
-}
-
-void __attribute__((used)) SPI_RX_DMA_IRQHandler(void)
-{
-  portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
 
   // Stop and cleanup DMA stream
   DMA_ITConfig(SPI_RX_DMA_STREAM, DMA_IT_TC, DISABLE);
-  DMA_ClearITPendingBit(SPI_RX_DMA_STREAM, SPI_RX_DMA_FLAG_TCIF);
-
-  // Clear stream flags
-  DMA_ClearFlag(SPI_RX_DMA_STREAM,SPI_RX_DMA_FLAG_TCIF);
 
   // Disable SPI DMA requests
+  SPI_I2S_DMACmd(SPI, SPI_I2S_DMAReq_Tx, DISABLE);
   SPI_I2S_DMACmd(SPI, SPI_I2S_DMAReq_Rx, DISABLE);
 
   // Disable streams
+  DMA_Cmd(SPI_TX_DMA_STREAM,DISABLE);
   DMA_Cmd(SPI_RX_DMA_STREAM,DISABLE);
 
   // Give the semaphore, allowing the SPI transaction to complete
-  xSemaphoreGiveFromISR(rxComplete, &xHigherPriorityTaskWoken);
+  xSemaphoreGiveFromISR(transferComplete, &xHigherPriorityTaskWoken);
 
   if (xHigherPriorityTaskWoken)
   {
@@ -36,30 +36,37 @@
 
 #include "stabilizer_types.h"
 #include "estimator.h"
-#include "estimator.h"
-
-#include "cf_math.h"
+#include "usec_time.h"
 
+#include <math.h>
 #include <stdlib.h>
+#include <string.h>
 
-#define AVERAGE_HISTORY_LENGTH 4
-#define OULIER_LIMIT 100
-#define LP_CONSTANT 0.8f
-// #define USE_LP_FILTER
-// #define USE_MA_SMOOTHING
+// The PMW3901 runs at about 121 frames per second. The motion registers are
+// read a bit faster than that and the deltas are accumulated until a new
+// frame with motion has been seen, or for at most FLOW_MAX_ACCUMULATION.
+#define FLOW_READ_PERIOD M2T(8)
+#define FLOW_MAX_ACCUMULATION 25000 // [us]
 
-#if defined(USE_MA_SMOOTHING)
-static struct {
-  float32_t averageX[AVERAGE_HISTORY_LENGTH];
-  float32_t averageY[AVERAGE_HISTORY_LENGTH];
-  size_t ptr;
-} pixelAverages;
-#endif
+#define OULIER_LIMIT 100 // [pixels] per measurement
+#define MEDIAN_HISTORY_LENGTH 5
 
-float dpixelx_previous = 0;
-float dpixely_previous = 0;
+// Motion data is not reliable when both the surface quality is low and the
+// shutter is at its max, see the PMW3901 datasheet
+#define SQUAL_MIN_DEFAULT 0x19
+#define SHUTTER_UPPER_MAX 0x1F
 
 static uint8_t outlierCount = 0;
+static uint8_t gatedCount = 0;
+static uint8_t squalMin = SQUAL_MIN_DEFAULT;
+// Max deviation of the flow from the running median [pixels/s]
+static uint16_t medianOutlierLimit = 5000;
+
+static struct {
+  float rateX[MEDIAN_HISTORY_LENGTH];
+  float rateY[MEDIAN_HISTORY_LENGTH];
+  uint32_t count;
+} rateHistory;
 
 static bool isInit1 = false;
 static bool isInit2 = false;
@@ -72,55 +79,96 @@ static bool useFlowDisabled = false;
 #define NCS_PIN DECK_GPIO_IO3
 
 
+static float median(const float* history)
+{
+  float sorted[MEDIAN_HISTORY_LENGTH];
+  memcpy(sorted, history, sizeof(sorted));
+
+  for (int i = 1; i < MEDIAN_HISTORY_LENGTH; i++) {
+    float value = sorted[i];
+    int j = i - 1;
+    while (j >= 0 && sorted[j] > value) {
+      sorted[j + 1] = sorted[j];
+      j--;
+    }
+    sorted[j + 1] = value;
+  }
+
+  return sorted[MEDIAN_HISTORY_LENGTH / 2];
+}
+
+// Compares the flow rate with the median of the previous ones. The rate is
+// added to the history even if it is rejected, to follow sustained changes.
+static bool isMedianOutlier(float rateX, float rateY)
+{
+  bool isOutlier = false;
+
+  if (rateHistory.count >= MEDIAN_HISTORY_LENGTH) {
+    isOutlier = fabsf(rateX - median(rateHistory.rateX)) > medianOutlierLimit ||
+                fabsf(rateY - median(rateHistory.rateY)) > medianOutlierLimit;
+  }
+
+  uint32_t index = rateHistory.count % MEDIAN_HISTORY_LENGTH;
+  rateHistory.rateX[index] = rateX;
+  rateHistory.rateY[index] = rateY;
+  rateHistory.count++;
+
+  return isOutlier;
+}
+
+static bool isMotionReliable(const motionBurst_t* motion)
+{
+  return motion->squal >= squalMin || (motion->shutter >> 8) != SHUTTER_UPPER_MAX;
+}
+
 static void flowdeckTask(void *param)
 {
   systemWaitStart();
 
+  TickType_t lastWakeTime = xTaskGetTickCount();
+  uint64_t accumulationStart = usecTimestamp();
+  int32_t accpx = 0;
+  int32_t accpy = 0;
+
   while(1) {
-    vTaskDelay(10);
+    vTaskDelayUntil(&lastWakeTime, FLOW_READ_PERIOD);
 
     pmw3901ReadMotion(NCS_PIN, &currentMotion);
+    uint64_t now = usecTimestamp();
+
+    if (!isMotionReliable(&currentMotion)) {
+      // Start over, the motion accumulated so far can not be trusted
+      gatedCount++;
+      accpx = 0;
+      accpy = 0;
+      accumulationStart = now;
+      continue;
+    }
 
     // Flip motion information to comply with sensor mounting
     // (might need to be changed if mounted differently)
-    int16_t accpx = -currentMotion.deltaY;
-    int16_t accpy = -currentMotion.deltaX;
+    accpx -= currentMotion.deltaY;
+    accpy -= currentMotion.deltaX;
+
+    uint32_t accumulationTime = (uint32_t)(now - accumulationStart);
+    if (!currentMotion.motionOccured && accumulationTime < FLOW_MAX_ACCUMULATION) {
+      continue;
+    }
 
-    // Outlier removal
-    if (abs(accpx) < OULIER_LIMIT && abs(accpy) < OULIER_LIMIT) {
+    float dt = accumulationTime / 1000000.0f;
+    bool isOutlier = abs(accpx) >= OULIER_LIMIT || abs(accpy) >= OULIER_LIMIT ||
+                     isMedianOutlier(accpx / dt, accpy / dt);
 
+    if (!isOutlier) {
       // Form flow measurement struct and push into the EKF
       flowMeasurement_t flowData;
+      flowData.timestamp = xTaskGetTickCount();
       flowData.stdDevX = 0.25;    // [pixels] should perhaps be made larger?
       flowData.stdDevY = 0.25;    // [pixels] should perhaps be made larger?
-      flowData.dt = 0.01;
-
-#if defined(USE_MA_SMOOTHING)
-      // Use MA Smoothing
-      pixelAverages.averageX[pixelAverages.ptr] = (float32_t)accpx;
-      pixelAverages.averageX[pixelAverages.ptr] = (float32_t)accpy;
-
-      float32_t meanX;
-      float32_t meanY;
-
-      arm_mean_f32(pixelAverages.averageX, AVERAGE_HISTORY_LENGTH, &meanX);
-      arm_mean_f32(pixelAverages.averageY, AVERAGE_HISTORY_LENGTH, &meanY);
-
-      pixelAverages.ptr = (pixelAverages.ptr + 1) % AVERAGE_HISTORY_LENGTH;
-
-      flowData.dpixelx = (float)meanX;   // [pixels]
-      flowData.dpixely = (float)meanY;   // [pixels]
-#elif defined(USE_LP_FILTER)
-      // Use LP filter measurements
-      flowData.dpixelx = LP_CONSTANT * dpixelx_previous + (1.0f - LP_CONSTANT) * (float)accpx;
-      flowData.dpixely = LP_CONSTANT * dpixely_previous + (1.0f - LP_CONSTANT) * (float)accpy;
-      dpixelx_previous = flowData.dpixelx;
-      dpixely_previous = flowData.dpixely;
-#else
-      // Use raw measurements
-      flowData.dpixelx = (float)accpx;
-      flowData.dpixely = (float)accpy;
-#endif
+      flowData.dt = dt;
+      flowData.dpixelx = (float)accpx;   // [pixels]
+      flowData.dpixely = (float)accpy;   // [pixels]
+
       // Push measurements into the estimator
       if (!useFlowDisabled) {
         estimatorEnqueueFlow(&flowData);
@@ -128,6 +176,10 @@ static void flowdeckTask(void *param)
     } else {
       outlierCount++;
     }
+
+    accpx = 0;
+    accpy = 0;
+    accumulationStart = now;
   }
 }
 
@@ -230,10 +282,14 @@ LOG_ADD(LOG_UINT8, maxRaw, &currentMotion.maxRawData)
 LOG_ADD(LOG_UINT8, minRaw, &currentMotion.minRawData)
 LOG_ADD(LOG_UINT8, Rawsum, &currentMotion.rawDataSum)
 LOG_ADD(LOG_UINT8, outlierCount, &outlierCount)
+LOG_ADD(LOG_UINT8, squal, &currentMotion.squal)
+LOG_ADD(LOG_UINT8, gatedCount, &gatedCount)
 LOG_GROUP_STOP(motion)
 
 PARAM_GROUP_START(motion)
 PARAM_ADD(PARAM_UINT8, disable, &useFlowDisabled)
+PARAM_ADD(PARAM_UINT8, squalMin, &squalMin)
+PARAM_ADD(PARAM_UINT16, outlierLim, &medianOutlierLimit)
 PARAM_GROUP_STOP(motion)
 
 PARAM_GROUP_START(deck)
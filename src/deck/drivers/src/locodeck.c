@@ -48,6 +48,7 @@
 #include "param.h"
 #include "nvicconf.h"
 #include "estimator.h"
+#include "usec_time.h"
 
 #include "locodeck.h"
 
@@ -188,6 +189,47 @@ uint8_t locoDeckGetActiveAnchorIdList(uint8_t unorderedAnchorList[], const int m
   return result;
 }
 
+/**
+ * Latency statistics, the max and mean values of a window are published for
+ * logging when the window ends.
+ */
+#define LATENCY_WINDOW M2T(1000)
+
+typedef struct {
+  uint32_t max;      // [us] Published max of the last window
+  uint32_t mean;     // [us] Published mean of the last window
+  uint32_t windowMax;
+  uint32_t windowSum;
+  uint32_t windowCount;
+  TickType_t windowEnd;
+} latencyStats_t;
+
+// Time of a DW1000 SPI transaction, including waiting for the bus
+static latencyStats_t spiLatency;
+// Time from the DW1000 interrupt until it has been handled by uwbTask
+static latencyStats_t irqLatency;
+static volatile uint32_t irqTimestamp;
+
+static void latencyUpdate(latencyStats_t* stats, uint32_t latency)
+{
+  TickType_t now = xTaskGetTickCount();
+
+  if ((int32_t)(now - stats->windowEnd) >= 0) {
+    stats->max = stats->windowMax;
+    stats->mean = stats->windowCount ? stats->windowSum / stats->windowCount : 0;
+    stats->windowMax = 0;
+    stats->windowSum = 0;
+    stats->windowCount = 0;
+    stats->windowEnd = now + LATENCY_WINDOW;
+  }
+
+  if (latency > stats->windowMax) {
+    stats->windowMax = latency;
+  }
+  stats->windowSum += latency;
+  stats->windowCount++;
+}
+
 static void uwbTask(void* parameters)
 {
   lppShortQueue = xQueueCreate(10, sizeof(lpsLppShortPacket_t));
@@ -263,6 +305,7 @@ static void uwbTask(void* parameters)
         dwHandleInterrupt(dwm);
         xSemaphoreGive(algoSemaphore);
       } while(digitalRead(GPIO_PIN_IRQ) != 0);
+      latencyUpdate(&irqLatency, (uint32_t)usecTimestamp() - irqTimestamp);
     } else {
       xSemaphoreTake(algoSemaphore, portMAX_DELAY);
       timeout = algorithm->onEvent(dwm, eventTimeout);
@@ -293,34 +336,43 @@ bool lpsGetLppShort(lpsLppShortPacket_t* shortPacket)
   return xQueueReceive(lppShortQueue, shortPacket, 0) == pdPASS;
 }
 
-static uint8_t spiTxBuffer[196];
-static uint8_t spiRxBuffer[196];
 static uint16_t spiSpeed = SPI_BAUDRATE_2MHZ;
 
 /************ Low level ops for libdw **********/
 static void spiWrite(dwDevice_t* dev, const void *header, size_t headerLength,
                                       const void* data, size_t dataLength)
 {
+  // Header and payload are sent directly from the callers buffers
+  const spiSegment_t segments[] = {
+    {headerLength, header, NULL},
+    {dataLength, data, NULL},
+  };
+
+  uint64_t start = usecTimestamp();
   spiBeginTransaction(spiSpeed);
   digitalWrite(CS_PIN, LOW);
-  memcpy(spiTxBuffer, header, headerLength);
-  memcpy(spiTxBuffer+headerLength, data, dataLength);
-  spiExchange(headerLength+dataLength, spiTxBuffer, spiRxBuffer);
+  spiExchangeSegments(segments, 2);
   digitalWrite(CS_PIN, HIGH);
   spiEndTransaction();
+  latencyUpdate(&spiLatency, (uint32_t)(usecTimestamp() - start));
 }
 
 static void spiRead(dwDevice_t* dev, const void *header, size_t headerLength,
                                      void* data, size_t dataLength)
 {
+  // The payload is received directly into the callers buffer
+  const spiSegment_t segments[] = {
+    {headerLength, header, NULL},
+    {dataLength, NULL, data},
+  };
+
+  uint64_t start = usecTimestamp();
   spiBeginTransaction(spiSpeed);
   digitalWrite(CS_PIN, LOW);
-  memcpy(spiTxBuffer, header, headerLength);
-  memset(spiTxBuffer+headerLength, 0, dataLength);
-  spiExchange(headerLength+dataLength, spiTxBuffer, spiRxBuffer);
-  memcpy(data, spiRxBuffer+headerLength, dataLength);
+  spiExchangeSegments(segments, 2);
   digitalWrite(CS_PIN, HIGH);
   spiEndTransaction();
+  latencyUpdate(&spiLatency, (uint32_t)(usecTimestamp() - start));
 }
 
 #if LOCODECK_USE_ALT_PINS
@@ -331,6 +383,8 @@ static void spiRead(dwDevice_t* dev, const void *header, size_t headerLength,
 	{
 	  portBASE_TYPE  xHigherPriorityTaskWoken = pdFALSE;
 
+	  irqTimestamp = (uint32_t)usecTimestamp();
+
 	  NVIC_ClearPendingIRQ(EXTI_IRQChannel);
 	  EXTI_ClearITPendingBit(EXTI_LineN);
 
@@ -506,6 +560,10 @@ LOG_GROUP_STOP(ranging)
 
 LOG_GROUP_START(loco)
 LOG_ADD(LOG_UINT8, mode, &algoOptions.currentRangingMode)
+LOG_ADD(LOG_UINT32, spiMax, &spiLatency.max)
+LOG_ADD(LOG_UINT32, spiMean, &spiLatency.mean)
+LOG_ADD(LOG_UINT32, irqMax, &irqLatency.max)
+LOG_ADD(LOG_UINT32, irqMean, &irqLatency.mean)
 LOG_GROUP_STOP(loco)
 
 PARAM_GROUP_START(loco)
@@ -52,65 +52,152 @@ static bool isPassed = false;
 #define MR_PIN_LEFT   PCA95X4_P6
 #define MR_PIN_RIGHT  PCA95X4_P2
 
-static VL53L1_Dev_t devFront;
-static VL53L1_Dev_t devBack;
-static VL53L1_Dev_t devUp;
-static VL53L1_Dev_t devLeft;
-static VL53L1_Dev_t devRight;
+#define MR_NBR_OF_SENSORS 5
+
+// Timing budget limits [ms]
+#define MR_DEFAULT_TIMING_BUDGET 41
+#define MR_MIN_TIMING_BUDGET     20
+#define MR_MAX_TIMING_BUDGET     1000
+// The inter measurement period must be a bit longer than the timing budget [ms]
+#define MR_INTER_MEASUREMENT_MARGIN 4
+// Time between polls when a measurement was not ready when expected [ms]
+#define MR_POLL_RETRY_PERIOD 1
+#define MR_RATE_WINDOW 1000
+
+/**
+ * The sensors range concurrently, each one with its own timing budget. The
+ * task polls a sensor when its measurement is expected to be ready and
+ * restarts it directly, so the update rate of each direction only depends on
+ * its own timing budget. The interrupt pins of the sensors are not connected
+ * to the Crazyflie, hence the polling.
+ */
+typedef struct
+{
+    VL53L1_Dev_t dev;
+    const char *name;
+    uint32_t pin;
+    rangeDirection_t direction;
+    bool isAvailable;
+    uint16_t timingBudget;        // [ms], set through parameters
+    uint16_t appliedTimingBudget; // [ms]
+    TickType_t nextPoll;
+    uint16_t measurementCount;
+    uint16_t rate;                // [Hz]
+} mrSensor_t;
+
+static mrSensor_t sensors[MR_NBR_OF_SENSORS] = {
+    {.name = "front", .pin = MR_PIN_FRONT, .direction = rangeFront, .timingBudget = MR_DEFAULT_TIMING_BUDGET},
+    {.name = "back", .pin = MR_PIN_BACK, .direction = rangeBack, .timingBudget = MR_DEFAULT_TIMING_BUDGET},
+    {.name = "up", .pin = MR_PIN_UP, .direction = rangeUp, .timingBudget = MR_DEFAULT_TIMING_BUDGET},
+    {.name = "left", .pin = MR_PIN_LEFT, .direction = rangeLeft, .timingBudget = MR_DEFAULT_TIMING_BUDGET},
+    {.name = "right", .pin = MR_PIN_RIGHT, .direction = rangeRight, .timingBudget = MR_DEFAULT_TIMING_BUDGET},
+};
 
-static uint16_t mrGetMeasurementAndRestart(VL53L1_Dev_t *dev)
+static void mrStartRanging(mrSensor_t *sensor, TickType_t now)
+{
+    uint16_t timingBudget = sensor->timingBudget;
+    if (timingBudget < MR_MIN_TIMING_BUDGET)
+    {
+        timingBudget = MR_MIN_TIMING_BUDGET;
+    }
+    else if (timingBudget > MR_MAX_TIMING_BUDGET)
+    {
+        timingBudget = MR_MAX_TIMING_BUDGET;
+    }
+    sensor->timingBudget = timingBudget;
+
+    VL53L1_StopMeasurement(&sensor->dev);
+    VL53L1_SetMeasurementTimingBudgetMicroSeconds(&sensor->dev, timingBudget * 1000);
+    VL53L1_SetInterMeasurementPeriodMilliSeconds(&sensor->dev, timingBudget + MR_INTER_MEASUREMENT_MARGIN);
+    VL53L1_StartMeasurement(&sensor->dev);
+
+    sensor->appliedTimingBudget = timingBudget;
+    sensor->nextPoll = now + M2T(timingBudget);
+}
+
+static void mrPollSensor(mrSensor_t *sensor, TickType_t now)
 {
-    VL53L1_Error status = VL53L1_ERROR_NONE;
     VL53L1_RangingMeasurementData_t rangingData;
     uint8_t dataReady = 0;
-    uint16_t range;
 
-    while (dataReady == 0)
+    if (VL53L1_GetMeasurementDataReady(&sensor->dev, &dataReady) != VL53L1_ERROR_NONE || dataReady == 0)
     {
-        status = VL53L1_GetMeasurementDataReady(dev, &dataReady);
-        vTaskDelay(M2T(1));
+        sensor->nextPoll = now + M2T(MR_POLL_RETRY_PERIOD);
+        return;
     }
 
-    status = VL53L1_GetRangingMeasurementData(dev, &rangingData);
-    range = rangingData.RangeMilliMeter;
+    if (VL53L1_GetRangingMeasurementData(&sensor->dev, &rangingData) == VL53L1_ERROR_NONE)
+    {
+        rangeSet(sensor->direction, rangingData.RangeMilliMeter / 1000.0f);
+        sensor->measurementCount++;
+    }
 
-    VL53L1_StopMeasurement(dev);
-    status = VL53L1_StartMeasurement(dev);
-    status = status;
+    if (sensor->timingBudget != sensor->appliedTimingBudget)
+    {
+        mrStartRanging(sensor, now);
+    }
+    else
+    {
+        VL53L1_ClearInterruptAndStartMeasurement(&sensor->dev);
+        sensor->nextPoll = now + M2T(sensor->appliedTimingBudget);
+    }
+}
 
-    return range;
+static void mrUpdateRates(TickType_t windowLength)
+{
+    for (int i = 0; i < MR_NBR_OF_SENSORS; i++)
+    {
+        sensors[i].rate = (sensors[i].measurementCount * M2T(1000)) / windowLength;
+        sensors[i].measurementCount = 0;
+    }
 }
 
 static void mrTask(void *param)
 {
-    VL53L1_Error status = VL53L1_ERROR_NONE;
-
     systemWaitStart();
 
-    // Restart all sensors
-    status = VL53L1_StopMeasurement(&devFront);
-    status = VL53L1_StartMeasurement(&devFront);
-    status = VL53L1_StopMeasurement(&devBack);
-    status = VL53L1_StartMeasurement(&devBack);
-    status = VL53L1_StopMeasurement(&devUp);
-    status = VL53L1_StartMeasurement(&devUp);
-    status = VL53L1_StopMeasurement(&devLeft);
-    status = VL53L1_StartMeasurement(&devLeft);
-    status = VL53L1_StopMeasurement(&devRight);
-    status = VL53L1_StartMeasurement(&devRight);
-    status = status;
-
-    TickType_t lastWakeTime = xTaskGetTickCount();
+    TickType_t now = xTaskGetTickCount();
+    TickType_t rateWindowStart = now;
 
-    while (1)
+    for (int i = 0; i < MR_NBR_OF_SENSORS; i++)
     {
-        vTaskDelayUntil(&lastWakeTime, M2T(100));
+        if (sensors[i].isAvailable)
+        {
+            mrStartRanging(&sensors[i], now);
+        }
+    }
 
-        rangeSet(rangeFront, mrGetMeasurementAndRestart(&devFront)/1000.0f);
-        rangeSet(rangeBack, mrGetMeasurementAndRestart(&devBack)/1000.0f);
-        rangeSet(rangeUp, mrGetMeasurementAndRestart(&devUp)/1000.0f);
-        rangeSet(rangeLeft, mrGetMeasurementAndRestart(&devLeft)/1000.0f);
-        rangeSet(rangeRight, mrGetMeasurementAndRestart(&devRight)/1000.0f);
+    while (1)
+    {
+        // Sleep until the first sensor is expected to have a measurement ready
+        TickType_t nextPoll = now + M2T(MR_RATE_WINDOW);
+        for (int i = 0; i < MR_NBR_OF_SENSORS; i++)
+        {
+            if (sensors[i].isAvailable && (int32_t)(sensors[i].nextPoll - nextPoll) < 0)
+            {
+                nextPoll = sensors[i].nextPoll;
+            }
+        }
+
+        if ((int32_t)(nextPoll - now) > 0)
+        {
+            vTaskDelay(nextPoll - now);
+        }
+        now = xTaskGetTickCount();
+
+        for (int i = 0; i < MR_NBR_OF_SENSORS; i++)
+        {
+            if (sensors[i].isAvailable && (int32_t)(now - sensors[i].nextPoll) >= 0)
+            {
+                mrPollSensor(&sensors[i], now);
+            }
+        }
+
+        if (now - rateWindowStart >= M2T(MR_RATE_WINDOW))
+        {
+            mrUpdateRates(now - rateWindowStart);
+            rateWindowStart = now;
+        }
     }
 }
 
@@ -150,59 +237,19 @@ static bool mrTest()
 
     isPassed = isInit;
 
-    pca95x4SetOutput(MR_PIN_FRONT);
-    if (vl53l1xInit(&devFront, I2C1_DEV))
+    for (int i = 0; i < MR_NBR_OF_SENSORS; i++)
     {
-        DEBUG_PRINT("Init front sensor [OK]\n");
-    }
-    else
-    {
-        DEBUG_PRINT("Init front sensor [FAIL]\n");
-        isPassed = false;
-    }
-
-    pca95x4SetOutput(MR_PIN_BACK);
-    if (vl53l1xInit(&devBack, I2C1_DEV))
-    {
-        DEBUG_PRINT("Init back sensor [OK]\n");
-    }
-    else
-    {
-        DEBUG_PRINT("Init back sensor [FAIL]\n");
-        isPassed = false;
-    }
-
-    pca95x4SetOutput(MR_PIN_UP);
-    if (vl53l1xInit(&devUp, I2C1_DEV))
-    {
-        DEBUG_PRINT("Init up sensor [OK]\n");
-    }
-    else
-    {
-        DEBUG_PRINT("Init up sensor [FAIL]\n");
-        isPassed = false;
-    }
-
-    pca95x4SetOutput(MR_PIN_LEFT);
-    if (vl53l1xInit(&devLeft, I2C1_DEV))
-    {
-        DEBUG_PRINT("Init left sensor [OK]\n");
-    }
-    else
-    {
-        DEBUG_PRINT("Init left sensor [FAIL]\n");
-        isPassed = false;
-    }
-
-    pca95x4SetOutput(MR_PIN_RIGHT);
-    if (vl53l1xInit(&devRight, I2C1_DEV))
-    {
-        DEBUG_PRINT("Init right sensor [OK]\n");
-    }
-    else
-    {
-        DEBUG_PRINT("Init right sensor [FAIL]\n");
-        isPassed = false;
+        pca95x4SetOutput(sensors[i].pin);
+        if (vl53l1xInit(&sensors[i].dev, I2C1_DEV))
+        {
+            DEBUG_PRINT("Init %s sensor [OK]\n", sensors[i].name);
+            sensors[i].isAvailable = true;
+        }
+        else
+        {
+            DEBUG_PRINT("Init %s sensor [FAIL]\n", sensors[i].name);
+            isPassed = false;
+        }
     }
 
     isTested = true;
@@ -226,3 +273,19 @@ DECK_DRIVER(multiranger_deck);
 PARAM_GROUP_START(deck)
 PARAM_ADD(PARAM_UINT8 | PARAM_RONLY, bcMultiranger, &isInit)
 PARAM_GROUP_STOP(deck)
+
+PARAM_GROUP_START(mr)
+PARAM_ADD(PARAM_UINT16, tbFront, &sensors[0].timingBudget)
+PARAM_ADD(PARAM_UINT16, tbBack, &sensors[1].timingBudget)
+PARAM_ADD(PARAM_UINT16, tbUp, &sensors[2].timingBudget)
+PARAM_ADD(PARAM_UINT16, tbLeft, &sensors[3].timingBudget)
+PARAM_ADD(PARAM_UINT16, tbRight, &sensors[4].timingBudget)
+PARAM_GROUP_STOP(mr)
+
+LOG_GROUP_START(mr)
+LOG_ADD(LOG_UINT16, rateFront, &sensors[0].rate)
+LOG_ADD(LOG_UINT16, rateBack, &sensors[1].rate)
+LOG_ADD(LOG_UINT16, rateUp, &sensors[2].rate)
+LOG_ADD(LOG_UINT16, rateLeft, &sensors[3].rate)
+LOG_ADD(LOG_UINT16, rateRight, &sensors[4].rate)
+LOG_GROUP_STOP(mr)
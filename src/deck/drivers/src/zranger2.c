@@ -44,6 +44,7 @@
 #include "stabilizer_types.h"
 
 #include "estimator.h"
+#include "estimator_kalman.h"
 #include "cf_math.h"
 
 // Measurement noise model
@@ -55,33 +56,106 @@ static float expCoeff;
 
 #define RANGE_OUTLIER_LIMIT 5000 // the measured range is in [mm]
 
+// The noise model above is tuned for the default timing budget of the sensor
+#define REFERENCE_TIMING_BUDGET 41.0f // [ms]
+// The inter measurement period must be a bit longer than the timing budget [ms]
+#define INTER_MEASUREMENT_MARGIN 4
+// Number of invalid measurements in a row that makes us switch to a longer range profile
+#define INVALID_MEASUREMENTS_LIMIT 3
+// Time to stay in a profile selected due to bad signal before moving down again
+#define SIGNAL_SWITCH_HOLD_TIME M2T(1000)
+
+/**
+ * Ranging profiles, from fast and short range to slow and long range. The
+ * profile is selected from the height estimate, with some hysteresis, and is
+ * moved up when the signal is lost.
+ */
+typedef struct {
+  VL53L1_DistanceModes distanceMode;
+  uint16_t timingBudget; // [ms]
+  float minHeight;       // [m] move down a profile below this height
+  float maxHeight;       // [m] move up a profile above this height
+} zRanger2Profile_t;
+
+static const zRanger2Profile_t profiles[] = {
+  {VL53L1_DISTANCEMODE_SHORT, 20, 0.0f, 1.0f},
+  {VL53L1_DISTANCEMODE_MEDIUM, 33, 0.8f, 2.2f},
+  {VL53L1_DISTANCEMODE_LONG, 50, 1.9f, 100.0f},
+};
+#define NBR_OF_PROFILES (sizeof(profiles) / sizeof(profiles[0]))
+
+static uint8_t profile = 0;
+static float stdScale = 1.0f;
+static uint8_t invalidCount = 0;
+static TickType_t holdUntil = 0;
+
+// Switching statistics
+static uint16_t heightSwitchCount = 0;
+static uint16_t signalSwitchCount = 0;
+static uint16_t invalidTotalCount = 0;
+
 static uint16_t range_last = 0;
 
 static bool isInit;
 
 static VL53L1_Dev_t dev;
 
-static uint16_t zRanger2GetMeasurementAndRestart(VL53L1_Dev_t *dev)
+static void zRanger2ApplyProfile(uint8_t newProfile)
+{
+  const zRanger2Profile_t* p = &profiles[newProfile];
+
+  VL53L1_StopMeasurement(&dev);
+  VL53L1_SetDistanceMode(&dev, p->distanceMode);
+  VL53L1_SetMeasurementTimingBudgetMicroSeconds(&dev, p->timingBudget * 1000);
+  VL53L1_SetInterMeasurementPeriodMilliSeconds(&dev, p->timingBudget + INTER_MEASUREMENT_MARGIN);
+  VL53L1_StartMeasurement(&dev);
+
+  // The measurement noise grows as the timing budget gets shorter
+  stdScale = sqrtf(REFERENCE_TIMING_BUDGET / p->timingBudget);
+  profile = newProfile;
+  invalidCount = 0;
+}
+
+static uint8_t zRanger2SelectProfile(float height, bool isSignalLost)
 {
-    VL53L1_Error status = VL53L1_ERROR_NONE;
-    VL53L1_RangingMeasurementData_t rangingData;
-    uint8_t dataReady = 0;
-    uint16_t range;
-
-    while (dataReady == 0)
-    {
-        status = VL53L1_GetMeasurementDataReady(dev, &dataReady);
-        vTaskDelay(M2T(1));
+  TickType_t now = xTaskGetTickCount();
+  uint8_t newProfile = profile;
+
+  if (isSignalLost) {
+    if (profile < NBR_OF_PROFILES - 1) {
+      newProfile = profile + 1;
+      holdUntil = now + SIGNAL_SWITCH_HOLD_TIME;
+      signalSwitchCount++;
     }
+  } else if (height > profiles[profile].maxHeight && profile < NBR_OF_PROFILES - 1) {
+    newProfile = profile + 1;
+    heightSwitchCount++;
+  } else if (height < profiles[profile].minHeight && profile > 0 && (int32_t)(now - holdUntil) >= 0) {
+    newProfile = profile - 1;
+    heightSwitchCount++;
+  }
 
-    status = VL53L1_GetRangingMeasurementData(dev, &rangingData);
-    range = rangingData.RangeMilliMeter;
+  return newProfile;
+}
 
-    VL53L1_StopMeasurement(dev);
-    status = VL53L1_StartMeasurement(dev);
-    status = status;
+static bool zRanger2GetMeasurement(VL53L1_RangingMeasurementData_t *rangingData)
+{
+  uint8_t dataReady = 0;
+
+  while (dataReady == 0)
+  {
+    if (VL53L1_GetMeasurementDataReady(&dev, &dataReady) != VL53L1_ERROR_NONE) {
+      return false;
+    }
+    if (dataReady == 0) {
+      vTaskDelay(M2T(1));
+    }
+  }
 
-    return range;
+  VL53L1_Error status = VL53L1_GetRangingMeasurementData(&dev, rangingData);
+  VL53L1_ClearInterruptAndStartMeasurement(&dev);
+
+  return status == VL53L1_ERROR_NONE;
 }
 
 void zRanger2Init(DeckInfo* info)
@@ -117,33 +191,53 @@ bool zRanger2Test(void)
 
 void zRanger2Task(void* arg)
 {
-  TickType_t lastWakeTime;
+  VL53L1_RangingMeasurementData_t rangingData;
 
   systemWaitStart();
 
-  // Restart sensor
-  VL53L1_StopMeasurement(&dev);
-  VL53L1_StartMeasurement(&dev);
-
-  lastWakeTime = xTaskGetTickCount();
+  // Start with the short range profile, we are most likely on the ground
+  zRanger2ApplyProfile(0);
 
   while (1) {
-    vTaskDelayUntil(&lastWakeTime, M2T(100));
-
-    range_last = zRanger2GetMeasurementAndRestart(&dev);
-    rangeSet(rangeDown, range_last / 1000.0f);
-
-    // check if range is feasible and push into the kalman filter
-    // the sensor should not be able to measure >5 [m], and outliers typically
-    // occur as >8 [m] measurements
-    if (getStateEstimator() == kalmanEstimator &&
-        range_last < RANGE_OUTLIER_LIMIT) {
-      // Form measurement
-      tofMeasurement_t tofData;
-      tofData.timestamp = xTaskGetTickCount();
-      tofData.distance = (float)range_last * 0.001f; // Scale from [mm] to [m]
-      tofData.stdDev = expStdA * (1.0f  + expf( expCoeff * ( tofData.distance - expPointA)));
-      estimatorEnqueueTOF(&tofData);
+    // Sleep until the measurement is expected to be ready
+    vTaskDelay(M2T(profiles[profile].timingBudget));
+
+    bool isValid = zRanger2GetMeasurement(&rangingData) &&
+                   rangingData.RangeStatus == VL53L1_RANGESTATUS_RANGE_VALID;
+
+    if (isValid) {
+      invalidCount = 0;
+      range_last = rangingData.RangeMilliMeter;
+      rangeSet(rangeDown, range_last / 1000.0f);
+
+      // check if range is feasible and push into the kalman filter
+      // the sensor should not be able to measure >5 [m], and outliers typically
+      // occur as >8 [m] measurements
+      if (getStateEstimator() == kalmanEstimator &&
+          range_last < RANGE_OUTLIER_LIMIT) {
+        // Form measurement
+        tofMeasurement_t tofData;
+        tofData.timestamp = xTaskGetTickCount();
+        tofData.distance = (float)range_last * 0.001f; // Scale from [mm] to [m]
+        tofData.stdDev = stdScale * expStdA * (1.0f  + expf( expCoeff * ( tofData.distance - expPointA)));
+        estimatorEnqueueTOF(&tofData);
+      }
+    } else {
+      invalidCount++;
+      invalidTotalCount++;
+    }
+
+    // Use the estimated height if available, it is valid also when the signal is lost
+    float height = range_last * 0.001f;
+    if (getStateEstimator() == kalmanEstimator) {
+      point_t position;
+      estimatorKalmanGetEstimatedPos(&position);
+      height = position.z;
+    }
+
+    uint8_t newProfile = zRanger2SelectProfile(height, invalidCount >= INVALID_MEASUREMENTS_LIMIT);
+    if (newProfile != profile) {
+      zRanger2ApplyProfile(newProfile);
     }
   }
 }
@@ -179,3 +273,10 @@ DECK_DRIVER(zranger2_deck);
 PARAM_GROUP_START(deck)
 PARAM_ADD(PARAM_UINT8 | PARAM_RONLY, bcZRanger2, &isInit)
 PARAM_GROUP_STOP(deck)
+
+LOG_GROUP_START(zr2)
+LOG_ADD(LOG_UINT8, profile, &profile)
+LOG_ADD(LOG_UINT16, heightSw, &heightSwitchCount)
+LOG_ADD(LOG_UINT16, signalSw, &signalSwitchCount)
+LOG_ADD(LOG_UINT16, invalid, &invalidTotalCount)
+LOG_GROUP_STOP(zr2)
@@ -47,4 +47,22 @@ void spiEndTransaction();
 /* Send the data_tx buffer and receive into the data_rx buffer */
 bool spiExchange(size_t length, const uint8_t *data_tx, uint8_t *data_rx);
 
+/**
+ * One part of a scatter/gather transfer. If tx is NULL, length fill bytes (0x00)
+ * are sent. If rx is NULL, the received bytes are discarded.
+ */
+typedef struct {
+  size_t length;
+  const uint8_t *tx;
+  uint8_t *rx;
+} spiSegment_t;
+
+/**
+ * Exchange a list of segments as one continuous transfer, without copying the
+ * buffers. The DMA is re-armed from the interrupt between segments and the
+ * calling task is only woken up when the last segment is done. The segment
+ * array must stay valid until the function returns.
+ */
+bool spiExchangeSegments(const spiSegment_t *segments, size_t nbrOfSegments);
+
 #endif /* SPI_H_ */
@@ -4,11 +4,16 @@
 #include "FreeRTOS.h"
 #include "semphr.h"
 #include "queue.h"
+#ifndef UNIT_TEST_MODE
 /* ST includes */
 #include "stm32fxxx.h"
+#endif
 
 #define I2C_NO_INTERNAL_ADDRESS   0xFFFF
 
+// Max number of transactions waiting in the asynchronous queue of a bus
+#define I2C_TRANSACTION_QUEUE_LENGTH  8
+
 typedef enum
 {
   i2cAck,
@@ -38,6 +43,41 @@ typedef struct _I2cMessage
   uint8_t          *buffer;           //< Pointer to the buffer from where data will be read for transmission, or into which received data will be placed.
 } I2cMessage;
 
+typedef struct _I2cTransaction I2cTransaction;
+
+/**
+ * Called from the i2c bus task when an asynchronous transaction is done.
+ */
+typedef void (*I2cTransactionCallback)(I2cTransaction* transaction);
+
+/**
+ * A chain of messages that is transferred in one bus session, the messages are
+ * separated by repeated starts and the bus is released after the last message.
+ * The chain is aborted on the first nack.
+ */
+struct _I2cTransaction
+{
+  I2cMessage             *messages;      //< The messages to transfer, must stay valid until done.
+  uint32_t               nbrOfMessages;  //< Number of messages in the chain
+  bool                   status;         //< True if all messages were acked, set when done.
+  I2cTransactionCallback callback;       //< Called when done, may be NULL.
+  xQueueHandle           clientQueue;    //< Queue that the transaction pointer is sent to when done, may be NULL.
+  void                   *userData;      //< Free for use by the client
+};
+
+typedef struct
+{
+  uint32_t messages;                     //< Number of messages transferred
+  uint32_t failures;                     //< Number of nacked or timed out messages
+  uint32_t timeouts;                     //< Number of bus restarts due to timeouts
+  uint32_t busyTime;                     //< Total time the bus has been busy (us)
+  uint16_t utilization;                  //< Busy time during the last second (per mille)
+  uint16_t queueMax;                     //< High water mark of the transaction queue
+  uint64_t windowStart;                  //< Start of the utilization window (us)
+  uint32_t windowBusyTime;               //< Busy time in the utilization window (us)
+} I2cBusStats;
+
+#ifndef UNIT_TEST_MODE
 typedef struct
 {
   I2C_TypeDef*        i2cPort;
@@ -62,6 +102,10 @@ typedef struct
   uint32_t            dmaRxTEFlag;
 
 } I2cDef;
+#else
+// The peripheral definition is opaque when running host side unit tests
+typedef struct I2cDef I2cDef;
+#endif
 
 typedef struct
 {
@@ -71,7 +115,14 @@ typedef struct
   uint32_t nbrOfretries;                //< Retries done
   SemaphoreHandle_t isBusFreeSemaphore; //< Semaphore to block during transaction.
   SemaphoreHandle_t isBusFreeMutex;     //< Mutex to protect buss
+  I2cMessage *chain;                    //< Messages transferred in the current bus session
+  uint32_t chainLength;                 //< Number of messages in the chain
+  uint32_t chainIndex;                  //< Index of the message currently on the bus
+  xQueueHandle transactionQueue;        //< Asynchronous transactions, created on first use
+  I2cBusStats stats;                    //< Bus statistics, available as log variables
+#ifndef UNIT_TEST_MODE
   DMA_InitTypeDef DMAStruct;            //< DMA configuration structure used during transfer setup.
+#endif
 } I2cDrv;
 
 // Definitions of i2c busses found in c file.
@@ -95,6 +146,43 @@ void i2cdrvInit(I2cDrv* i2c);
  */
 bool i2cdrvMessageTransfer(I2cDrv* i2c, I2cMessage* message);
 
+/**
+ * Send or receive a chain of messages in one bus session. The messages are
+ * separated by repeated starts so the bus is not released in between.
+ *
+ * @param i2c            i2c bus to use.
+ * @param messages       The messages to transfer. The status of each message is updated.
+ * @param nbrOfMessages  Number of messages in the chain.
+ * @return               true if all messages were successful, false otherwise.
+ */
+bool i2cdrvMessageTransferChain(I2cDrv* i2c, I2cMessage* messages, uint32_t nbrOfMessages);
+
+/**
+ * Create an asynchronous transaction.
+ *
+ * @param transaction    pointer to transaction struct that will be filled in.
+ * @param messages       The messages to transfer in one bus session.
+ * @param nbrOfMessages  Number of messages.
+ * @param callback       Called from the i2c bus task when done, may be NULL.
+ * @param userData       Client data passed on in the transaction.
+ */
+void i2cdrvCreateTransaction(I2cTransaction *transaction,
+                             I2cMessage *messages,
+                             uint32_t nbrOfMessages,
+                             I2cTransactionCallback callback,
+                             void *userData);
+
+/**
+ * Queue a transaction for asynchronous transfer. The call does not block, the
+ * transaction is transferred by the i2c bus task and the client is notified
+ * through the callback and/or the client queue of the transaction. The
+ * transaction and its messages must not be touched until then.
+ *
+ * @param i2c          i2c bus to use.
+ * @param transaction  The transaction to queue.
+ * @return             true if queued, false if the queue of the bus is full.
+ */
+bool i2cdrvTransactionEnqueue(I2cDrv* i2c, I2cTransaction* transaction);
 
 /**
  * Create a message to transfer
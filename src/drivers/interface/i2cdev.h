@@ -38,10 +38,30 @@
 
 #define I2CDEV_NO_MEM_ADDR  0xFF
 
+// Number of registers, starting at 0, covered by a register shadow cache
+#define I2CDEV_REG_CACHE_SIZE    128
+#define I2CDEV_MAX_REG_CACHES    4
+
 typedef I2cDrv    I2C_Dev;
 #define I2C1_DEV  &deckBus
 #define I2C3_DEV  &sensorsBus
 
+/**
+ * Shadow copy of the configuration registers of a device. When registered
+ * for a device, single register reads are served from the cache and bit
+ * writes are done with one write instead of a read-modify-write. Registers
+ * that are changed by the device itself (data, status, self clearing bits)
+ * must be marked as volatile, they always go to the bus.
+ */
+typedef struct
+{
+  I2C_Dev *dev;
+  uint8_t devAddress;
+  uint32_t validRegs[I2CDEV_REG_CACHE_SIZE / 32];
+  uint32_t volatileRegs[I2CDEV_REG_CACHE_SIZE / 32];
+  uint8_t values[I2CDEV_REG_CACHE_SIZE];
+} I2cdevRegCache;
+
 // For compatibility
 #define i2cdevWrite16 i2cdevWriteReg16
 #define i2cdevRead16  i2cdevReadReg16
@@ -205,4 +225,29 @@ bool i2cdevWriteBit(I2C_Dev *dev, uint8_t devAddress, uint8_t memAddress,
 bool i2cdevWriteBits(I2C_Dev *dev, uint8_t devAddress, uint8_t memAddress,
                      uint8_t bitStart, uint8_t length, uint8_t data);
 
+/**
+ * Register a register shadow cache for a device. The cache starts out empty
+ * and is filled as registers are read or written.
+ * @param cache  The cache to use, must be kept alive by the caller.
+ * @param dev  Pointer to I2C peripheral the device is connected to.
+ * @param devAddress  The device address.
+ *
+ * @return TRUE if the cache was registered, FALSE if all cache slots are used.
+ */
+bool i2cdevRegCacheInit(I2cdevRegCache *cache, I2C_Dev *dev, uint8_t devAddress);
+
+/**
+ * Mark a range of registers as volatile, they will never be cached.
+ * @param cache  The cache
+ * @param firstReg  The first register in the range.
+ * @param lastReg  The last register in the range, inclusive.
+ */
+void i2cdevRegCacheSetVolatile(I2cdevRegCache *cache, uint8_t firstReg, uint8_t lastReg);
+
+/**
+ * Drop all cached register values, for instance after a device reset.
+ * @param cache  The cache
+ */
+void i2cdevRegCacheInvalidate(I2cdevRegCache *cache);
+
 #endif //__I2CDEV_H__
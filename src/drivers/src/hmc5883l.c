@@ -44,6 +44,7 @@ static uint8_t buffer[6];
 static uint8_t mode;
 static I2C_Dev *I2Cx;
 static bool isInit;
+static I2cdevRegCache regCache;
 
 /** Power on and prepare for general usage.
  * This will prepare the magnetometer with default settings, ready for single-
@@ -61,6 +62,11 @@ void hmc5883lInit(I2C_Dev *i2cPort)
   I2Cx = i2cPort;
   devAddr = HMC5883L_ADDRESS;
 
+  // Shadow the configuration registers, the mode register returns to idle
+  // by itself after a single measurement so it is treated as volatile
+  i2cdevRegCacheInit(&regCache, I2Cx, devAddr);
+  i2cdevRegCacheSetVolatile(&regCache, HMC5883L_RA_MODE, HMC5883L_RA_STATUS);
+
   // write CONFIG_A register
   i2cdevWriteByte(I2Cx, devAddr, HMC5883L_RA_CONFIG_A,
       (HMC5883L_AVERAGING_8 << (HMC5883L_CRA_AVERAGE_BIT - HMC5883L_CRA_AVERAGE_LENGTH + 1)) |
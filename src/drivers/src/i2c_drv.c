@@ -47,11 +47,8 @@
 #include "i2c_drv.h"
 #include "config.h"
 #include "nvicconf.h"
-
-//DEBUG
-#ifdef I2CDRV_DEBUG_LOG_EVENTS
 #include "usec_time.h"
-#endif
+#include "log.h"
 
 // Definitions of sensors I2C bus
 #define I2C_DEFAULT_SENSORS_CLOCK_SPEED             400000
@@ -64,6 +61,7 @@
 #define I2C_SLAVE_ADDRESS7      0x30
 #define I2C_MAX_RETRIES         2
 #define I2C_MESSAGE_TIMEOUT     M2T(1000)
+#define I2C_STATS_WINDOW_US     1000000
 
 // Delay is approx 0.06us per loop @168Mhz
 #define I2CDEV_LOOPS_PER_US  17
@@ -213,12 +211,6 @@ static void i2cdrvStartTransfer(I2cDrv *i2c)
   i2c->def->i2cPort->CR1 = (I2C_CR1_START | I2C_CR1_PE);
 }
 
-static void i2cTryNextMessage(I2cDrv* i2c)
-{
-  i2c->def->i2cPort->CR1 = (I2C_CR1_STOP | I2C_CR1_PE);
-  I2C_ITConfig(i2c->def->i2cPort, I2C_IT_EVT | I2C_IT_BUF, DISABLE);
-}
-
 static void i2cNotifyClient(I2cDrv* i2c)
 {
   portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
@@ -226,6 +218,34 @@ static void i2cNotifyClient(I2cDrv* i2c)
   portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
 }
 
+static void i2cTryNextMessage(I2cDrv* i2c)
+{
+  if (i2c->chain == NULL || i2c->chainIndex >= i2c->chainLength)
+  {
+    // Late event, the client has given up on the chain and its messages may
+    // be gone. Release the bus without notifying anyone.
+    i2c->def->i2cPort->CR1 = (I2C_CR1_STOP | I2C_CR1_PE);
+    I2C_ITConfig(i2c->def->i2cPort, I2C_IT_EVT | I2C_IT_BUF, DISABLE);
+    return;
+  }
+
+  i2c->chain[i2c->chainIndex].status = i2c->txMessage.status;
+
+  if (i2c->txMessage.status == i2cAck && ++i2c->chainIndex < i2c->chainLength)
+  {
+    // More messages in the chain, continue with a repeated start
+    memcpy((char*)&i2c->txMessage, (char*)&i2c->chain[i2c->chainIndex], sizeof(I2cMessage));
+    i2c->txMessage.status = i2cAck;
+    i2cdrvStartTransfer(i2c);
+  }
+  else
+  {
+    i2c->def->i2cPort->CR1 = (I2C_CR1_STOP | I2C_CR1_PE);
+    I2C_ITConfig(i2c->def->i2cPort, I2C_IT_EVT | I2C_IT_BUF, DISABLE);
+    i2cNotifyClient(i2c);
+  }
+}
+
 static void i2cdrvTryToRestartBus(I2cDrv* i2c)
 {
   i2cdrvInitBus(i2c);
@@ -319,9 +339,6 @@ static void i2cdrvInitBus(I2cDrv* i2c)
   NVIC_Init(&NVIC_InitStructure);
 
   i2cdrvDmaSetupBus(i2c);
-
-  i2c->isBusFreeSemaphore = xSemaphoreCreateBinary();
-  i2c->isBusFreeMutex = xSemaphoreCreateMutex();
 }
 
 static void i2cdrvdevUnlockBus(GPIO_TypeDef* portSCL, GPIO_TypeDef* portSDA, uint16_t pinSCL, uint16_t pinSDA)
@@ -363,6 +380,13 @@ static void i2cdrvdevUnlockBus(GPIO_TypeDef* portSCL, GPIO_TypeDef* portSDA, uin
 
 void i2cdrvInit(I2cDrv* i2c)
 {
+  // Init is called by every device on the bus, the semaphores must only be created once
+  if (i2c->isBusFreeMutex == NULL)
+  {
+    i2c->isBusFreeSemaphore = xSemaphoreCreateBinary();
+    i2c->isBusFreeMutex = xSemaphoreCreateMutex();
+  }
+
   i2cdrvInitBus(i2c);
 }
 
@@ -400,34 +424,157 @@ void i2cdrvCreateMessageIntAddr(I2cMessage *message,
   message->nbrOfRetries = I2C_MAX_RETRIES;
 }
 
-bool i2cdrvMessageTransfer(I2cDrv* i2c, I2cMessage* message)
+void i2cdrvCreateTransaction(I2cTransaction *transaction,
+                             I2cMessage *messages,
+                             uint32_t nbrOfMessages,
+                             I2cTransactionCallback callback,
+                             void *userData)
+{
+  transaction->messages = messages;
+  transaction->nbrOfMessages = nbrOfMessages;
+  transaction->status = false;
+  transaction->callback = callback;
+  transaction->clientQueue = NULL;
+  transaction->userData = userData;
+}
+
+static void i2cdrvUpdateStats(I2cDrv* i2c, uint64_t start, const I2cMessage* messages, uint32_t nbrOfMessages)
+{
+  uint64_t now = usecTimestamp();
+  uint32_t busyTime = (uint32_t)(now - start);
+  uint32_t failures = 0;
+
+  for (uint32_t i = 0; i < nbrOfMessages; i++)
+  {
+    if (messages[i].status != i2cAck)
+    {
+      failures++;
+    }
+  }
+
+  i2c->stats.messages += nbrOfMessages;
+  i2c->stats.failures += failures;
+  i2c->stats.busyTime += busyTime;
+  i2c->stats.windowBusyTime += busyTime;
+
+  uint64_t windowLength = now - i2c->stats.windowStart;
+  if (windowLength >= I2C_STATS_WINDOW_US)
+  {
+    i2c->stats.utilization = (uint16_t)(((uint64_t)i2c->stats.windowBusyTime * 1000) / windowLength);
+    i2c->stats.windowBusyTime = 0;
+    i2c->stats.windowStart = now;
+  }
+}
+
+bool i2cdrvMessageTransferChain(I2cDrv* i2c, I2cMessage* messages, uint32_t nbrOfMessages)
 {
   bool status = false;
 
+  if (nbrOfMessages == 0)
+  {
+    return true;
+  }
+
   xSemaphoreTake(i2c->isBusFreeMutex, portMAX_DELAY); // Protect message data
-  // Copy message
-  memcpy((char*)&i2c->txMessage, (char*)message, sizeof(I2cMessage));
+  uint64_t start = usecTimestamp();
+
+  i2c->chain = messages;
+  i2c->chainLength = nbrOfMessages;
+  i2c->chainIndex = 0;
+  // Copy first message, the ISR moves on to the following ones
+  memcpy((char*)&i2c->txMessage, (char*)&messages[0], sizeof(I2cMessage));
+  i2c->txMessage.status = i2cAck;
   // We can now start the ISR sending this message.
   i2cdrvStartTransfer(i2c);
-  // Wait for transaction to be done
-  if (xSemaphoreTake(i2c->isBusFreeSemaphore, I2C_MESSAGE_TIMEOUT) == pdTRUE)
+  // Wait for all messages to be done
+  bool isDone = (xSemaphoreTake(i2c->isBusFreeSemaphore, I2C_MESSAGE_TIMEOUT * nbrOfMessages) == pdTRUE);
+
+  // The messages belong to the caller, the ISR must not touch them after return
+  taskENTER_CRITICAL();
+  uint32_t reached = i2c->chainIndex;
+  i2c->chain = NULL;
+  i2c->chainLength = 0;
+  taskEXIT_CRITICAL();
+
+  if (isDone)
   {
-    if (i2c->txMessage.status == i2cAck)
-    {
-      status = true;
-    }
+    status = (reached == nbrOfMessages);
   }
   else
   {
     i2cdrvClearDMA(i2c);
     i2cdrvTryToRestartBus(i2c);
+    i2c->stats.timeouts++;
     //TODO: If bus is really hanged... fail safe
   }
+
+  // Messages not reached due to a nack or a timeout are reported as nacked
+  for (uint32_t i = reached; i < nbrOfMessages; i++)
+  {
+    messages[i].status = i2cNack;
+  }
+
+  i2cdrvUpdateStats(i2c, start, messages, nbrOfMessages);
   xSemaphoreGive(i2c->isBusFreeMutex);
 
   return status;
 }
 
+bool i2cdrvMessageTransfer(I2cDrv* i2c, I2cMessage* message)
+{
+  return i2cdrvMessageTransferChain(i2c, message, 1);
+}
+
+static void i2cdrvBusTask(void* param)
+{
+  I2cDrv* i2c = (I2cDrv*)param;
+  I2cTransaction* transaction;
+
+  while (true)
+  {
+    xQueueReceive(i2c->transactionQueue, &transaction, portMAX_DELAY);
+
+    transaction->status = i2cdrvMessageTransferChain(i2c, transaction->messages, transaction->nbrOfMessages);
+
+    if (transaction->callback)
+    {
+      transaction->callback(transaction);
+    }
+    if (transaction->clientQueue)
+    {
+      xQueueSend(transaction->clientQueue, &transaction, portMAX_DELAY);
+    }
+  }
+}
+
+bool i2cdrvTransactionEnqueue(I2cDrv* i2c, I2cTransaction* transaction)
+{
+  // The queue and the bus task are only created when a bus is used asynchronously
+  if (i2c->transactionQueue == NULL)
+  {
+    xSemaphoreTake(i2c->isBusFreeMutex, portMAX_DELAY);
+    if (i2c->transactionQueue == NULL)
+    {
+      i2c->transactionQueue = xQueueCreate(I2C_TRANSACTION_QUEUE_LENGTH, sizeof(I2cTransaction*));
+      xTaskCreate(i2cdrvBusTask, I2C_BUS_TASK_NAME, I2C_BUS_TASK_STACKSIZE, i2c, I2C_BUS_TASK_PRI, NULL);
+    }
+    xSemaphoreGive(i2c->isBusFreeMutex);
+  }
+
+  if (xQueueSend(i2c->transactionQueue, &transaction, I2C_NO_BLOCK) != pdTRUE)
+  {
+    return false;
+  }
+
+  uint16_t queued = (uint16_t)uxQueueMessagesWaiting(i2c->transactionQueue);
+  if (queued > i2c->stats.queueMax)
+  {
+    i2c->stats.queueMax = queued;
+  }
+
+  return true;
+}
+
 
 static void i2cdrvEventIsrHandler(I2cDrv* i2c)
 {
@@ -519,8 +666,7 @@ static void i2cdrvEventIsrHandler(I2cDrv* i2c)
       }
       else
       {
-        i2cNotifyClient(i2c);
-        // Are there any other messages to transact? If so stop else repeated start.
+        // Are there any other messages to transact? If so repeated start else stop.
         i2cTryNextMessage(i2c);
       }
     }
@@ -530,7 +676,6 @@ static void i2cdrvEventIsrHandler(I2cDrv* i2c)
       i2c->txMessage.buffer[i2c->messageIndex++] = I2C_ReceiveData(i2c->def->i2cPort);
       if(i2c->messageIndex == i2c->txMessage.messageLength)
       {
-        i2cNotifyClient(i2c);
         // Are there any other messages to transact?
         i2cTryNextMessage(i2c);
       }
@@ -583,7 +728,6 @@ static void i2cdrvErrorIsrHandler(I2cDrv* i2c)
     {
       // Failed so notify client and try next message if any.
       i2c->txMessage.status = i2cNack;
-      i2cNotifyClient(i2c);
       i2cTryNextMessage(i2c);
     }
     I2C_ClearFlag(i2c->def->i2cPort, I2C_FLAG_AF);
@@ -616,7 +760,6 @@ static void i2cdrvDmaIsrHandler(I2cDrv* i2c)
   if (DMA_GetFlagStatus(i2c->def->dmaRxStream, i2c->def->dmaRxTCFlag)) // Tranasfer complete
   {
     i2cdrvClearDMA(i2c);
-    i2cNotifyClient(i2c);
     // Are there any other messages to transact?
     i2cTryNextMessage(i2c);
   }
@@ -625,7 +768,6 @@ static void i2cdrvDmaIsrHandler(I2cDrv* i2c)
     DMA_ClearITPendingBit(i2c->def->dmaRxStream, i2c->def->dmaRxTEFlag);
     //TODO: Best thing we could do?
     i2c->txMessage.status = i2cNack;
-    i2cNotifyClient(i2c);
     i2cTryNextMessage(i2c);
   }
 }
@@ -661,3 +803,15 @@ void __attribute__((used)) DMA1_Stream2_IRQHandler(void)
   i2cdrvDmaIsrHandler(&sensorsBus);
 }
 
+LOG_GROUP_START(i2c)
+LOG_ADD(LOG_UINT32, sensMsgs, &sensorsBus.stats.messages)
+LOG_ADD(LOG_UINT32, sensFail, &sensorsBus.stats.failures)
+LOG_ADD(LOG_UINT32, sensTimeout, &sensorsBus.stats.timeouts)
+LOG_ADD(LOG_UINT16, sensUtil, &sensorsBus.stats.utilization)
+LOG_ADD(LOG_UINT16, sensQMax, &sensorsBus.stats.queueMax)
+LOG_ADD(LOG_UINT32, deckMsgs, &deckBus.stats.messages)
+LOG_ADD(LOG_UINT32, deckFail, &deckBus.stats.failures)
+LOG_ADD(LOG_UINT32, deckTimeout, &deckBus.stats.timeouts)
+LOG_ADD(LOG_UINT16, deckUtil, &deckBus.stats.utilization)
+LOG_ADD(LOG_UINT16, deckQMax, &deckBus.stats.queueMax)
+LOG_GROUP_STOP(i2c)
@@ -28,6 +28,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 
 #include "FreeRTOS.h"
 #include "semphr.h"
@@ -39,6 +40,65 @@
 #include "nvicconf.h"
 #include "debug.h"
 
+static I2cdevRegCache *regCaches[I2CDEV_MAX_REG_CACHES];
+
+static I2cdevRegCache *regCacheFind(I2C_Dev *dev, uint8_t devAddress)
+{
+  for (int i = 0; i < I2CDEV_MAX_REG_CACHES; i++)
+  {
+    if (regCaches[i] && regCaches[i]->dev == dev && regCaches[i]->devAddress == devAddress)
+    {
+      return regCaches[i];
+    }
+  }
+
+  return 0;
+}
+
+static bool regCacheGet(I2C_Dev *dev, uint8_t devAddress, uint8_t memAddress, uint8_t *data)
+{
+  I2cdevRegCache *cache = regCacheFind(dev, devAddress);
+
+  if (cache && memAddress < I2CDEV_REG_CACHE_SIZE &&
+      (cache->validRegs[memAddress / 32] & (1 << (memAddress % 32))))
+  {
+    *data = cache->values[memAddress];
+    return true;
+  }
+
+  return false;
+}
+
+static void regCacheUpdate(I2C_Dev *dev, uint8_t devAddress, uint8_t memAddress,
+                           uint16_t len, const uint8_t *data, bool isValid)
+{
+  I2cdevRegCache *cache = regCacheFind(dev, devAddress);
+
+  if (!cache)
+  {
+    return;
+  }
+
+  for (uint32_t reg = memAddress; reg < (uint32_t)memAddress + len && reg < I2CDEV_REG_CACHE_SIZE; reg++)
+  {
+    uint32_t mask = 1u << (reg % 32);
+    if (cache->volatileRegs[reg / 32] & mask)
+    {
+      continue;
+    }
+
+    if (isValid)
+    {
+      cache->values[reg] = data[reg - memAddress];
+      cache->validRegs[reg / 32] |= mask;
+    }
+    else
+    {
+      cache->validRegs[reg / 32] &= ~mask;
+    }
+  }
+}
+
 int i2cdevInit(I2C_Dev *dev)
 {
   i2cdrvInit(dev);
@@ -46,9 +106,45 @@ int i2cdevInit(I2C_Dev *dev)
   return true;
 }
 
+bool i2cdevRegCacheInit(I2cdevRegCache *cache, I2C_Dev *dev, uint8_t devAddress)
+{
+  for (int i = 0; i < I2CDEV_MAX_REG_CACHES; i++)
+  {
+    if (regCaches[i] == 0 || regCaches[i] == cache)
+    {
+      memset(cache, 0, sizeof(I2cdevRegCache));
+      cache->dev = dev;
+      cache->devAddress = devAddress;
+      regCaches[i] = cache;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void i2cdevRegCacheSetVolatile(I2cdevRegCache *cache, uint8_t firstReg, uint8_t lastReg)
+{
+  for (uint32_t reg = firstReg; reg <= lastReg && reg < I2CDEV_REG_CACHE_SIZE; reg++)
+  {
+    cache->volatileRegs[reg / 32] |= 1u << (reg % 32);
+    cache->validRegs[reg / 32] &= ~(1u << (reg % 32));
+  }
+}
+
+void i2cdevRegCacheInvalidate(I2cdevRegCache *cache)
+{
+  memset(cache->validRegs, 0, sizeof(cache->validRegs));
+}
+
 bool i2cdevReadByte(I2C_Dev *dev, uint8_t devAddress, uint8_t memAddress,
                     uint8_t *data)
 {
+  if (regCacheGet(dev, devAddress, memAddress, data))
+  {
+    return true;
+  }
+
   return i2cdevReadReg8(dev, devAddress, memAddress, 1, data);
 }
 
@@ -58,7 +154,7 @@ bool i2cdevReadBit(I2C_Dev *dev, uint8_t devAddress, uint8_t memAddress,
   uint8_t byte;
   bool status;
 
-  status = i2cdevReadReg8(dev, devAddress, memAddress, 1, &byte);
+  status = i2cdevReadByte(dev, devAddress, memAddress, &byte);
   *data = byte & (1 << bitNum);
 
   return status;
@@ -97,7 +193,13 @@ bool i2cdevReadReg8(I2C_Dev *dev, uint8_t devAddress, uint8_t memAddress,
   i2cdrvCreateMessageIntAddr(&message, devAddress, false, memAddress,
                             i2cRead, len, data);
 
-  return i2cdrvMessageTransfer(dev, &message);
+  if (i2cdrvMessageTransfer(dev, &message))
+  {
+    regCacheUpdate(dev, devAddress, memAddress, len, data, true);
+    return true;
+  }
+
+  return false;
 }
 
 bool i2cdevReadReg16(I2C_Dev *dev, uint8_t devAddress, uint16_t memAddress,
@@ -162,7 +264,11 @@ bool i2cdevWriteReg8(I2C_Dev *dev, uint8_t devAddress, uint8_t memAddress,
   i2cdrvCreateMessageIntAddr(&message, devAddress, false, memAddress,
                              i2cWrite, len, data);
 
-  return i2cdrvMessageTransfer(dev, &message);
+  bool status = i2cdrvMessageTransfer(dev, &message);
+  // The register content is unknown if the write failed
+  regCacheUpdate(dev, devAddress, memAddress, len, data, status);
+
+  return status;
 }
 
 bool i2cdevWriteReg16(I2C_Dev *dev, uint8_t devAddress, uint16_t memAddress,
@@ -33,6 +33,7 @@
 
 #include "ina219.h"
 #include "i2cdev.h"
+#include "i2c_drv.h"
 #include "debug.h"
 #include "eprintf.h"
 #include "param.h"
@@ -46,6 +47,12 @@ static int16_t loadVoltage=0, shuntVoltage=0;
 static int16_t loadCurrent=0;
 static uint16_t ina219_currentDivider_mA; 
 
+// The task reads the registers asynchronously, in one bus session
+static I2cTransaction transaction;
+static I2cMessage messages[3];
+static uint8_t busVoltageData[2], shuntVoltageData[2], currentData[2];
+static volatile bool isTransactionPending;
+
 static void ina219Task(void *param);
 
 bool ina219Init(I2C_Dev *i2cPort)
@@ -168,25 +175,50 @@ bool ina219GetData(int16_t *measuredValue)
   return status;
 }
 
+static int16_t ina219Combine(const uint8_t *data)
+{
+  return (int16_t)(((data[0] & 0xFF) << 8) | data[1]);
+}
+
+// Called from the i2c bus task
+static void ina219TransactionDone(I2cTransaction *done)
+{
+  if (done->status)
+  {
+    int16_t busVoltage = (ina219Combine(busVoltageData) >> 3) * 4;
+
+    shuntVoltage = ina219Combine(shuntVoltageData);
+    loadVoltage = busVoltage + shuntVoltage;
+    loadCurrent = ina219Combine(currentData);
+  }
+
+  isTransactionPending = false;
+}
+
 static void ina219Task(void *param)
 {
-  int16_t measuredValue;
+  i2cdrvCreateMessageIntAddr(&messages[0], devAddr, false, INA219_REG_BUSVOLTAGE,
+                             i2cRead, 2, busVoltageData);
+  i2cdrvCreateMessageIntAddr(&messages[1], devAddr, false, INA219_REG_SHUNTVOLTAGE,
+                             i2cRead, 2, shuntVoltageData);
+  i2cdrvCreateMessageIntAddr(&messages[2], devAddr, false, INA219_REG_CURRENT,
+                             i2cRead, 2, currentData);
+  i2cdrvCreateTransaction(&transaction, messages, 3, ina219TransactionDone, NULL);
 
   while (1)
   {
     vTaskDelay(M2T(100));
 
-    //DEBUG_PRINT("Measure INA 219\n");
-    ina219GetData(&measuredValue);
-
-  // #ifdef MEASURE_VOLTAGE
-  //       DEBUG_PRINT("Measured Voltage is %d\n",measuredValue);
-  // #endif      
-
-  // #ifdef MEASURE_CURRENT
-  //       DEBUG_PRINT("Measured Current is %d\n",measuredValue);
-  // #endif
-  }  
+    // The last reading may still be waiting for the bus, it is not queued twice
+    if (!isTransactionPending)
+    {
+      isTransactionPending = true;
+      if (!i2cdrvTransactionEnqueue(I2Cx, &transaction))
+      {
+        isTransactionPending = false;
+      }
+    }
+  }
 }
 
 // PARAM_GROUP_START(current_sensor)
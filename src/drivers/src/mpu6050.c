@@ -44,6 +44,7 @@ static uint8_t devAddr;
 static I2C_Dev *I2Cx;
 static uint8_t buffer[14];
 static bool isInit;
+static I2cdevRegCache regCache;
 
 /** Default constructor, uses default I2C address.
  * @see MPU6050_DEFAULT_ADDRESS
@@ -57,6 +58,17 @@ void mpu6050Init(I2C_Dev *i2cPort)
   devAddr = MPU6050_ADDRESS_AD0_HIGH;
 //FIXME    devAddr = MPU6050_ADDRESS_AD0_LOW;
 
+  // Shadow the configuration registers to avoid read-modify-write of bits.
+  // Data, status, FIFO, memory access and self clearing reset registers
+  // are updated by the device and always read from the bus.
+  i2cdevRegCacheInit(&regCache, I2Cx, devAddr);
+  i2cdevRegCacheSetVolatile(&regCache, MPU6050_RA_I2C_SLV4_CTRL, MPU6050_RA_I2C_MST_STATUS);
+  i2cdevRegCacheSetVolatile(&regCache, MPU6050_RA_INT_STATUS, MPU6050_RA_MOT_DETECT_STATUS);
+  i2cdevRegCacheSetVolatile(&regCache, MPU6050_RA_SIGNAL_PATH_RESET, MPU6050_RA_SIGNAL_PATH_RESET);
+  i2cdevRegCacheSetVolatile(&regCache, MPU6050_RA_USER_CTRL, MPU6050_RA_PWR_MGMT_1);
+  i2cdevRegCacheSetVolatile(&regCache, MPU6050_RA_BANK_SEL, MPU6050_RA_MEM_R_W);
+  i2cdevRegCacheSetVolatile(&regCache, MPU6050_RA_FIFO_COUNTH, MPU6050_RA_FIFO_R_W);
+
   isInit = true;
 }
 
@@ -2794,6 +2806,8 @@ void mpu6050ResetSensors()
 void mpu6050Reset()
 {
   i2cdevWriteBit(I2Cx, devAddr, MPU6050_RA_PWR_MGMT_1, MPU6050_PWR1_DEVICE_RESET_BIT, 1);
+  // All registers return to their default values
+  i2cdevRegCacheInvalidate(&regCache);
 }
 /** Get sleep mode status.
  * Setting the SLEEP bit in the register puts the device into very low power
@@ -45,6 +45,7 @@ static uint8_t devAddr;
 static I2C_Dev *I2Cx;
 static uint8_t buffer[14];
 static bool isInit;
+static I2cdevRegCache regCache;
 
 static const unsigned short mpu6500StTb[256] = {
   2620,2646,2672,2699,2726,2753,2781,2808, //7
@@ -92,6 +93,17 @@ void mpu6500Init(I2C_Dev *i2cPort)
   I2Cx = i2cPort;
   devAddr = MPU6500_ADDRESS_AD0_HIGH;
 
+  // Shadow the configuration registers to avoid read-modify-write of bits.
+  // Data, status, FIFO, memory access and self clearing reset registers
+  // are updated by the device and always read from the bus.
+  i2cdevRegCacheInit(&regCache, I2Cx, devAddr);
+  i2cdevRegCacheSetVolatile(&regCache, MPU6500_RA_I2C_SLV4_CTRL, MPU6500_RA_I2C_MST_STATUS);
+  i2cdevRegCacheSetVolatile(&regCache, MPU6500_RA_INT_STATUS, MPU6500_RA_MOT_DETECT_STATUS);
+  i2cdevRegCacheSetVolatile(&regCache, MPU6500_RA_SIGNAL_PATH_RESET, MPU6500_RA_SIGNAL_PATH_RESET);
+  i2cdevRegCacheSetVolatile(&regCache, MPU6500_RA_USER_CTRL, MPU6500_RA_PWR_MGMT_1);
+  i2cdevRegCacheSetVolatile(&regCache, MPU6500_RA_BANK_SEL, MPU6500_RA_MEM_R_W);
+  i2cdevRegCacheSetVolatile(&regCache, MPU6500_RA_FIFO_COUNTH, MPU6500_RA_FIFO_R_W);
+
   isInit = true;
 }
 
@@ -2643,6 +2655,8 @@ void mpu6500ResetSensors()
 void mpu6500Reset()
 {
   i2cdevWriteBit(I2Cx, devAddr, MPU6500_RA_PWR_MGMT_1, MPU6500_PWR1_DEVICE_RESET_BIT, 1);
+  // All registers return to their default values
+  i2cdevRegCacheInvalidate(&regCache);
 }
 /** Get sleep mode status.
  * Setting the SLEEP bit in the register puts the device into very low power
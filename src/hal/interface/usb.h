@@ -81,5 +81,11 @@ bool usbGetDataBlocking(USBPacket *in);
  */
 bool usbSendData(uint32_t size, uint8_t* data);
 
+/**
+ * Set a function to call, from the USB interrupt, when a packet is taken
+ * from the tx queue and there is room for the next one.
+ */
+void usbSetSendReadyCallback(void (*cb)(void));
+
 
 #endif /* UART_H_ */
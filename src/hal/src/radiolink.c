@@ -54,10 +54,12 @@ static bool isInit;
 static int radiolinkSendCRTPPacket(CRTPPacket *p);
 static int radiolinkSetEnable(bool enable);
 static int radiolinkReceiveCRTPPacket(CRTPPacket *p);
+static void radiolinkSetReadyCallback(crtpLinkReadyCallback cb);
 
 //Local RSSI variable used to enable logging of RSSI values from Radio
 static uint8_t rssi;
 static uint32_t lastPacketTick;
+static crtpLinkReadyCallback readyCallback;
 
 
 static bool radiolinkIsConnected(void) {
@@ -69,7 +71,8 @@ static struct crtpLinkOperations radiolinkOp =
   .setEnable         = radiolinkSetEnable,
   .sendPacket        = radiolinkSendCRTPPacket,
   .receivePacket     = radiolinkReceiveCRTPPacket,
-  .isConnected       = radiolinkIsConnected
+  .isConnected       = radiolinkIsConnected,
+  .setReadyCallback  = radiolinkSetReadyCallback,
 };
 
 void radiolinkInit(void)
@@ -158,6 +161,11 @@ void radiolinkSyslinkDispatch(SyslinkPacket *slp)
     {
       ledseqRun(LINK_DOWN_LED, seq_linkup);
       syslinkSendPacket(&txPacket);
+      // There is room for the next packet
+      if (readyCallback)
+      {
+        readyCallback();
+      }
     }
   } else if (slp->type == SYSLINK_RADIO_RAW_BROADCAST)
   {
@@ -192,7 +200,8 @@ static int radiolinkSendCRTPPacket(CRTPPacket *p)
   slp.length = p->size + 1;
   memcpy(slp.data, &p->header, p->size + 1);
 
-  if (xQueueSend(txQueue, &slp, M2T(100)) == pdTRUE)
+  // Do not block, CRTP waits for the ready callback
+  if (xQueueSend(txQueue, &slp, 0) == pdTRUE)
   {
     return true;
   }
@@ -210,6 +219,11 @@ static int radiolinkSetEnable(bool enable)
   return 0;
 }
 
+static void radiolinkSetReadyCallback(crtpLinkReadyCallback cb)
+{
+  readyCallback = cb;
+}
+
 LOG_GROUP_START(radio)
 LOG_ADD(LOG_UINT8, rssi, &rssi)
 LOG_GROUP_STOP(radio)
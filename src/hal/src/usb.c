@@ -55,6 +55,7 @@ static bool doingTransfer = false;
 
 static xQueueHandle usbDataRx;
 static xQueueHandle usbDataTx;
+static void (*sendReadyCallback)(void);
 
 /* Endpoints */
 #define IN_EP                       0x81  /* EP1 for data IN */
@@ -231,6 +232,10 @@ static uint8_t  usbd_cf_DataIn (void *pdev, uint8_t epnum)
               IN_EP,
               (uint8_t*)outPacket.data,
               outPacket.size);
+    if (sendReadyCallback)
+    {
+      sendReadyCallback();
+    }
   }
 
   portYIELD_FROM_ISR(xTaskWokenByReceive);
@@ -250,6 +255,10 @@ static uint8_t  usbd_cf_SOF (void *pdev)
                 IN_EP,
                 (uint8_t*)outPacket.data,
                 outPacket.size);
+      if (sendReadyCallback)
+      {
+        sendReadyCallback();
+      }
     }
   }
 
@@ -403,6 +412,11 @@ bool usbSendData(uint32_t size, uint8_t* data)
 {
   outStage.size = size;
   memcpy(outStage.data, data, size);
-  // Dont' block when sending
-  return (xQueueSend(usbDataTx, &outStage, M2T(100)) == pdTRUE);
+  // Dont' block when sending, the ready callback tells when there is room
+  return (xQueueSend(usbDataTx, &outStage, 0) == pdTRUE);
+}
+
+void usbSetSendReadyCallback(void (*cb)(void))
+{
+  sendReadyCallback = cb;
 }
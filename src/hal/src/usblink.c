@@ -49,6 +49,7 @@ static uint8_t sendBuffer[64];
 static int usblinkSendPacket(CRTPPacket *p);
 static int usblinkSetEnable(bool enable);
 static int usblinkReceiveCRTPPacket(CRTPPacket *p);
+static void usblinkSetReadyCallback(crtpLinkReadyCallback cb);
 
 
 static struct crtpLinkOperations usblinkOp =
@@ -56,6 +57,7 @@ static struct crtpLinkOperations usblinkOp =
   .setEnable         = usblinkSetEnable,
   .sendPacket        = usblinkSendPacket,
   .receivePacket     = usblinkReceiveCRTPPacket,
+  .setReadyCallback  = usblinkSetReadyCallback,
 };
 
 /* Radio task handles the CRTP packet transfers as well as the radio link
@@ -114,6 +116,11 @@ static int usblinkSetEnable(bool enable)
   return 0;
 }
 
+static void usblinkSetReadyCallback(crtpLinkReadyCallback cb)
+{
+  usbSetSendReadyCallback(cb);
+}
+
 /*
  * Public functions
  */
@@ -105,7 +105,7 @@ void crtpRegisterPortCB(int port, CrtpCallback cb);
 /**
  * Put a packet in the TX task
  *
- * If the TX stack is full, the oldest lowest priority packet is dropped
+ * If the TX queue of the class of the packet is full, the packet is dropped
  *
  * @param[in] p CRTPPacket to send
  */
@@ -140,11 +140,13 @@ int crtpReceivePacket(CRTPPort taskId, CRTPPacket *p);
 int crtpReceivePacketWait(CRTPPort taskId, CRTPPacket *p, int wait);
 
 /**
- * Get the number of free tx packets in the queue
+ * Get the number of free tx packets in the queue the data of a port is sent
+ * from. The ports do not share one queue, see crtp.c.
  *
+ * @param[in] portId The port, for the log port the queue of the log data
  * @return Number of free packets
  */
-int crtpGetFreeTxQueuePackets(void);
+int crtpGetFreeTxQueuePackets(CRTPPort portId);
 
 /**
  * Wait for a packet to arrive for the specified taskID
@@ -156,6 +158,8 @@ int crtpGetFreeTxQueuePackets(void);
  */
 int crtpReceivePacketBlock(CRTPPort taskId, CRTPPacket *p);
 
+typedef void (*crtpLinkReadyCallback)(void);
+
 /**
  * Function pointer structure to be filled by the CRTP link to permits CRTP to
  * use manu link
@@ -167,6 +171,12 @@ struct crtpLinkOperations
   int (*receivePacket)(CRTPPacket *pk);
   bool (*isConnected)(void);
   int (*reset)(void);
+  /**
+   * Optional. Set the function the link calls, from a task or an interrupt,
+   * when it has room again after sendPacket() failed. A link that sets it
+   * should not block in sendPacket().
+   */
+  void (*setReadyCallback)(crtpLinkReadyCallback cb);
 };
 
 void crtpSetLink(struct crtpLinkOperations * lk);
@@ -58,6 +58,8 @@
 #include "stabilizer_types.h"
 
 void estimatorKalmanInit(void);
+// Register the param callbacks, at boot whatever the estimator
+void estimatorKalmanParamInit(void);
 bool estimatorKalmanTest(void);
 void estimatorKalman(state_t *state, sensorData_t *sensors, control_t *control, const uint32_t tick);
 
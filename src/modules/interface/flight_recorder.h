@@ -0,0 +1,105 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie Firmware
+ *
+ * Copyright (C) 2019 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * flight_recorder.h: Records log variables at the rate of the stabilizer
+ *                    loop in RAM, around an incident
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * The recorder samples up to FLIGHT_RECORDER_MAX_VARS log variables in a ring
+ * buffer. When one of the enabled triggers fires it records the post trigger
+ * part of the window and then freezes, keeping the window until it is
+ * re-armed. The buffer is not cleared at startup, a window that was frozen
+ * by an assert can be read after the watchdog reset.
+ *
+ * The recorder is accessed through the memory subsystem. The memory starts
+ * with a 48 byte header, all values little endian:
+ *
+ *  0 version         Format version, 1
+ *  1 state           flightRecorderState_t, write a single byte to arm (recording) or stop (off)
+ *  2 reason          Trigger that froze the window
+ *  3 frameSize       Bytes per frame
+ *  4 frameCount      uint16, frames in the frozen window
+ *  6 triggerFrame    uint16, index of the frame the trigger was handled in
+ *  8 triggerTime     uint32, stabilizer tick of the trigger
+ * 12 triggerMask     Enabled triggers, bit n for flightRecorderTrigger_t n
+ * 13 divider         Sample every divider stabilizer ticks
+ * 14 postPercent     Part of the window recorded after the trigger, 0-100
+ * 15 varCount        Number of variables
+ * 16 varIds          uint16[FLIGHT_RECORDER_MAX_VARS], log TOC ids of the variables
+ *
+ * Bytes 12 to 47 can only be written when the recorder is off. The frames of
+ * a frozen window follow the header, oldest first. Each frame is the uint32
+ * stabilizer tick followed by the variables in their log type.
+ */
+
+#ifndef FLIGHT_RECORDER_BUFFER_SIZE
+#define FLIGHT_RECORDER_BUFFER_SIZE (16 * 1024)
+#endif
+#define FLIGHT_RECORDER_MAX_VARS 16
+#define FLIGHT_RECORDER_HEADER_SIZE 48
+
+typedef enum {
+  flightRecorderStateOff = 0,
+  flightRecorderStateRecording = 1,
+  flightRecorderStateTriggered = 2,  // Recording the post trigger part of the window
+  flightRecorderStateFrozen = 3,
+} flightRecorderState_t;
+
+typedef enum {
+  flightRecorderTriggerEmergencyStop = 0,
+  flightRecorderTriggerTumble = 1,
+  flightRecorderTriggerAssert = 2,
+  flightRecorderTriggerParamWrite = 3,
+} flightRecorderTrigger_t;
+
+void flightRecorderInit(void);
+
+/**
+ * Sample the variables, called by the stabilizer loop at every tick.
+ *
+ * @param tick  The stabilizer tick, stored with the sample.
+ */
+void flightRecorderUpdate(uint32_t tick);
+
+/**
+ * Report a trigger. Safe to call from any task, the trigger is handled at the
+ * next sample.
+ */
+void flightRecorderTrigger(flightRecorderTrigger_t trigger);
+
+/**
+ * Freeze the window right away, for when the stabilizer loop will not run
+ * again. Only to be called with interrupts disabled.
+ */
+void flightRecorderFreeze(flightRecorderTrigger_t trigger);
+
+/* Memory subsystem access */
+uint32_t flightRecorderMemSize(void);
+bool flightRecorderMemRead(uint32_t offset, uint8_t length, uint8_t* dest);
+bool flightRecorderMemWrite(uint32_t offset, uint8_t length, const uint8_t* src);
@@ -36,6 +36,7 @@ bool logTest(void);
 
 /* Internal access of log variables */
 int logGetVarId(char* group, char* name);
+int logGetVarIdFromToc(int tocId);
 int logGetType(int varid);
 void logGetGroupAndName(int varid, char** group, char** name);
 void* logGetAddress(int varid);
@@ -44,9 +45,17 @@ float logGetFloat(int varid);
 int logGetInt(int varid);
 unsigned int logGetUint(int varid);
 
+/* Samples the aggregated log variables, called by the stabilizer loop */
+void logAggregationUpdate(void);
+
+/* Serialized toc, for bulk download through the memory subsystem */
+uint32_t logTocImageSize(void);
+bool logTocImageRead(uint32_t offset, uint8_t length, uint8_t* dest);
+
 /* Basic log structure */
 struct log_s {
   uint8_t type;
+  uint8_t count;  // Number of elements of arrays, 0 for single variables
   char * name;
   void * address;
 };
@@ -63,6 +72,7 @@ struct log_s {
 
 /* Internal defines */
 #define LOG_GROUP 0x80
+#define LOG_ARRAY 0x40  // Set in the toc image type of arrays, with the element count
 #define LOG_START 1
 #define LOG_STOP  0
 
@@ -70,6 +80,10 @@ struct log_s {
 #define LOG_ADD(TYPE, NAME, ADDRESS) \
    { .type = TYPE, .name = #NAME, .address = (void*)(ADDRESS), },
 
+// An array of COUNT elements of TYPE, blocks can log any slice of it
+#define LOG_ADD_ARRAY(TYPE, NAME, ADDRESS, COUNT) \
+   { .type = TYPE, .count = COUNT, .name = #NAME, .address = (void*)(ADDRESS), },
+
 #define LOG_ADD_GROUP(TYPE, NAME, ADDRESS) \
    { \
   .type = TYPE, .name = #NAME, .address = (void*)(ADDRESS), },
@@ -0,0 +1,81 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie Firmware
+ *
+ * Copyright (C) 2019 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * occupancy_grid.h: Horizontal occupancy grid around the Crazyflie, built
+ *                   from the range sensors
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include "stabilizer_types.h"
+
+// Number of cells along each side of the grid, must be a power of two
+#define OCCUPANCY_GRID_SIZE 64
+// Side of a cell (m)
+#define OCCUPANCY_GRID_RESOLUTION 0.1f
+// Max distance from the Crazyflie, in cells, searched for the nearest obstacle
+#define OCCUPANCY_GRID_SEARCH_RADIUS 16
+// Rate of occupancyGridUpdate() in the stabilizer loop
+#define OCCUPANCY_GRID_UPDATE_RATE RATE_25_HZ
+
+/**
+ * Clear all cells. The grid is centered around the next position it is updated with.
+ */
+void occupancyGridReset();
+
+/**
+ * Update the grid with the horizontal ranges that have been set since the last
+ * call. The grid moves along with the Crazyflie and cells that fall outside
+ * of it are forgotten.
+ *
+ * @param state The current state estimate, must contain a valid position.
+ */
+void occupancyGridUpdate(const state_t *state);
+
+/**
+ * Insert one range measurement. Cells along the ray are marked as free and the
+ * cell at the end of the ray as occupied if isHit is true.
+ *
+ * @param x      Origin of the ray (m)
+ * @param y      Origin of the ray (m)
+ * @param angle  Direction of the ray in the world frame (rad)
+ * @param range  Length of the ray (m)
+ * @param isHit  True if the ray ended on an obstacle
+ */
+void occupancyGridInsertRay(float x, float y, float angle, float range, bool isHit);
+
+/**
+ * @return True if the cell containing the point is occupied.
+ */
+bool occupancyGridIsOccupied(float x, float y);
+
+/**
+ * Get the nearest obstacle found at the last update. Cheap enough to be called
+ * every tick.
+ *
+ * @param obstacle  Filled in with the center of the nearest occupied cell
+ * @param distance  Filled in with the horizontal distance to the obstacle (m)
+ * @return True if there is an obstacle within OCCUPANCY_GRID_SEARCH_RADIUS.
+ */
+bool occupancyGridGetNearestObstacle(point_t *obstacle, float *distance);
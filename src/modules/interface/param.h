@@ -34,6 +34,33 @@
 void paramInit(void);
 bool paramTest(void);
 
+/* Serialized toc, for bulk download through the memory subsystem */
+uint32_t paramTocImageSize(void);
+bool paramTocImageRead(uint32_t offset, uint8_t length, uint8_t* dest);
+
+/* Public API to access param TOC from within the copter */
+int paramGetVarId(char* group, char* name);
+
+typedef void (*paramCallback_t)(void);
+
+/**
+ * Register a function to call when a client writes a variable, alone or in a
+ * transaction. The write is applied by the stabilizer loop at the top of its
+ * run and the function is called right after, from the same place, instead of
+ * the module polling the variable. It must be short. If the loop is not
+ * running the param task applies the write and calls the function. To be
+ * called at init, before the system is started.
+ *
+ * @param varid  The variable, from paramGetVarId()
+ * @return false if the variable does not exist or there is no room left
+ */
+bool paramAddCallback(int varid, paramCallback_t callback);
+
+/**
+ * Apply a committed transaction, called at the top of the stabilizer loop.
+ */
+void paramCommitTransaction(void);
+
 /* Basic parameter structure */
 struct param_s {
   uint8_t type;
@@ -57,6 +84,8 @@ struct param_s {
 #define PARAM_GROUP    (0x01<<7)
 
 #define PARAM_RONLY (1<<6)
+// The value can be stored in the eeprom, it is restored at startup
+#define PARAM_PERSISTENT (1<<4)
 
 #define PARAM_START 1
 #define PARAM_STOP  0
@@ -27,6 +27,8 @@
 
 #pragma once
 
+#include <stdint.h>
+
 typedef enum {
     rangeFront=0,
     rangeBack,
@@ -51,4 +53,13 @@ void rangeSet(rangeDirection_t direction, float range_m);
  * @param direction Direction of the range
  * @return Distance to an object in meter
  */
-float rangeGet(rangeDirection_t direction);
\ No newline at end of file
+float rangeGet(rangeDirection_t direction);
+
+/**
+ * Get the number of times the range for a certain direction has been set,
+ * used to detect new measurements
+ *
+ * @param direction Direction of the range
+ * @return Number of updates
+ */
+uint32_t rangeGetUpdateCount(rangeDirection_t direction);
@@ -0,0 +1,134 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie Firmware
+ *
+ * Copyright (C) 2019 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * toc_index.h: Index for fast lookup of log and param variables by id and
+ *              by name
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum {
+  tocEntryVariable,
+  tocEntryGroupStart,
+  tocEntryGroupStop,
+} tocEntryKind_t;
+
+typedef struct {
+  tocEntryKind_t kind;
+  uint8_t type;       // Type as sent in the toc, including group flags
+  const char* name;
+  uint8_t count;      // Number of elements of array variables, 0 otherwise
+} tocEntry_t;
+
+/**
+ * Get entry i of a toc. Implemented by the owner of the toc.
+ */
+typedef void (*tocIndexGetEntry_t)(int i, tocEntry_t* entry);
+
+typedef struct {
+  uint16_t len;       // Number of entries in the toc, including groups
+  uint16_t count;     // Number of variables in the toc, groups are not counted
+  uint16_t* entries;  // Variable id -> index of the variable in the toc
+  uint16_t* groups;   // Variable id -> index of the start entry of its group
+  uint16_t* sorted;   // Variable ids sorted on group name and variable name
+  tocIndexGetEntry_t getEntry;
+
+  // Serialized toc image, see tocIndexImageRead()
+  uint32_t imageSize;
+  uint16_t imageEntry;   // Read cursor, entry and its offset in the image
+  uint32_t imageOffset;
+} tocIndex_t;
+
+// Number of uint16_t needed to index a toc with count variables
+#define TOC_INDEX_STORAGE_SIZE(count) (3 * (count))
+
+#define TOC_IMAGE_VERSION 2
+#define TOC_IMAGE_HEADER_SIZE 7
+
+/**
+ * Count the variables in a toc.
+ *
+ * @param len       Number of entries in the toc, including groups
+ * @param getEntry  Accessor for the entries of the toc
+ */
+int tocIndexCountVariables(int len, tocIndexGetEntry_t getEntry);
+
+/**
+ * Build the index of a toc. The toc must not change after this call.
+ *
+ * @param index     The index to build
+ * @param len       Number of entries in the toc, including groups
+ * @param getEntry  Accessor for the entries of the toc
+ * @param storage   Space for the index, TOC_INDEX_STORAGE_SIZE(count) items
+ */
+void tocIndexInit(tocIndex_t* index, int len, tocIndexGetEntry_t getEntry, uint16_t* storage);
+
+/**
+ * @return The index in the toc of variable id, or -1 if there is no such variable.
+ */
+int tocIndexGetEntry(const tocIndex_t* index, int id);
+
+/**
+ * @return The index in the toc of the start of the group of variable id, or -1
+ *         if there is no such variable.
+ */
+int tocIndexGetGroup(const tocIndex_t* index, int id);
+
+/**
+ * Find a variable by name. If a name occurs more than once, the first one in
+ * the toc is returned.
+ *
+ * @return The id of the variable, or -1 if it does not exist.
+ */
+int tocIndexFindId(const tocIndex_t* index, const char* group, const char* name);
+
+/**
+ * @return The size in bytes of the serialized toc image.
+ */
+uint32_t tocIndexImageSize(const tocIndex_t* index);
+
+/**
+ * Read part of a serialized image of the toc, that lets a client download the
+ * whole toc with a few memory reads instead of one request per variable.
+ * The image is generated on the fly from the toc. Sequential reads are served
+ * in constant time, reading backwards restarts from the start of the toc.
+ *
+ * Image format, little endian:
+ *   header:  version (uint8), variable count (uint16), toc crc (uint32)
+ *   entries: type (uint8), name (zero terminated string), and for variables
+ *            the number of elements (uint8, 0 if the variable is not an array)
+ * The entries are the group starts and variables of the toc, in toc order.
+ * A type with bit 7 set is the start of a group, the following variables
+ * belong to it. Variable ids are implicit, the n:th variable has id n.
+ *
+ * @param index   The toc index
+ * @param crc     The crc of the toc, as sent in the toc info
+ * @param offset  Offset in the image of the first byte to read
+ * @param length  Number of bytes to read
+ * @param dest    Destination of the data
+ * @return False if the read is outside of the image.
+ */
+bool tocIndexImageRead(tocIndex_t* index, uint32_t crc, uint32_t offset, uint8_t length, uint8_t* dest);
@@ -298,25 +298,25 @@ void controllerMellinger(control_t *control, setpoint_t *setpoint,
 }
 
 PARAM_GROUP_START(ctrlMel)
-PARAM_ADD(PARAM_FLOAT, kp_xy, &kp_xy)
-PARAM_ADD(PARAM_FLOAT, kd_xy, &kd_xy)
-PARAM_ADD(PARAM_FLOAT, ki_xy, &ki_xy)
-PARAM_ADD(PARAM_FLOAT, i_range_xy, &i_range_xy)
-PARAM_ADD(PARAM_FLOAT, kp_z, &kp_z)
-PARAM_ADD(PARAM_FLOAT, kd_z, &kd_z)
-PARAM_ADD(PARAM_FLOAT, ki_z, &ki_z)
-PARAM_ADD(PARAM_FLOAT, i_range_z, &i_range_z)
-PARAM_ADD(PARAM_FLOAT, mass, &g_vehicleMass)
-PARAM_ADD(PARAM_FLOAT, massThrust, &massThrust)
-PARAM_ADD(PARAM_FLOAT, kR_xy, &kR_xy)
-PARAM_ADD(PARAM_FLOAT, kR_z, &kR_z)
-PARAM_ADD(PARAM_FLOAT, kw_xy, &kw_xy)
-PARAM_ADD(PARAM_FLOAT, kw_z, &kw_z)
-PARAM_ADD(PARAM_FLOAT, ki_m_xy, &ki_m_xy)
-PARAM_ADD(PARAM_FLOAT, ki_m_z, &ki_m_z)
-PARAM_ADD(PARAM_FLOAT, kd_omega_rp, &kd_omega_rp)
-PARAM_ADD(PARAM_FLOAT, i_range_m_xy, &i_range_m_xy)
-PARAM_ADD(PARAM_FLOAT, i_range_m_z, &i_range_m_z)
+PARAM_ADD(PARAM_FLOAT | PARAM_PERSISTENT, kp_xy, &kp_xy)
+PARAM_ADD(PARAM_FLOAT | PARAM_PERSISTENT, kd_xy, &kd_xy)
+PARAM_ADD(PARAM_FLOAT | PARAM_PERSISTENT, ki_xy, &ki_xy)
+PARAM_ADD(PARAM_FLOAT | PARAM_PERSISTENT, i_range_xy, &i_range_xy)
+PARAM_ADD(PARAM_FLOAT | PARAM_PERSISTENT, kp_z, &kp_z)
+PARAM_ADD(PARAM_FLOAT | PARAM_PERSISTENT, kd_z, &kd_z)
+PARAM_ADD(PARAM_FLOAT | PARAM_PERSISTENT, ki_z, &ki_z)
+PARAM_ADD(PARAM_FLOAT | PARAM_PERSISTENT, i_range_z, &i_range_z)
+PARAM_ADD(PARAM_FLOAT | PARAM_PERSISTENT, mass, &g_vehicleMass)
+PARAM_ADD(PARAM_FLOAT | PARAM_PERSISTENT, massThrust, &massThrust)
+PARAM_ADD(PARAM_FLOAT | PARAM_PERSISTENT, kR_xy, &kR_xy)
+PARAM_ADD(PARAM_FLOAT | PARAM_PERSISTENT, kR_z, &kR_z)
+PARAM_ADD(PARAM_FLOAT | PARAM_PERSISTENT, kw_xy, &kw_xy)
+PARAM_ADD(PARAM_FLOAT | PARAM_PERSISTENT, kw_z, &kw_z)
+PARAM_ADD(PARAM_FLOAT | PARAM_PERSISTENT, ki_m_xy, &ki_m_xy)
+PARAM_ADD(PARAM_FLOAT | PARAM_PERSISTENT, ki_m_z, &ki_m_z)
+PARAM_ADD(PARAM_FLOAT | PARAM_PERSISTENT, kd_omega_rp, &kd_omega_rp)
+PARAM_ADD(PARAM_FLOAT | PARAM_PERSISTENT, i_range_m_xy, &i_range_m_xy)
+PARAM_ADD(PARAM_FLOAT | PARAM_PERSISTENT, i_range_m_z, &i_range_m_z)
 PARAM_GROUP_STOP(ctrlMel)
 
 LOG_GROUP_START(ctrlMel)
@@ -26,6 +26,7 @@
 
 #include <stdbool.h>
 #include <errno.h>
+#include <string.h>
 
 /*FreeRtos includes*/
 #include "FreeRTOS.h"
@@ -39,6 +40,13 @@
 #include "info.h"
 #include "cfassert.h"
 #include "queuemonitor.h"
+#include "usec_time.h"
+
+#ifdef STM32F40_41xxx
+#include "stm32f4xx.h"
+#else
+#include "stm32f10x.h"
+#endif
 
 #include "log.h"
 
@@ -54,6 +62,39 @@ static struct crtpLinkOperations nopLink = {
 
 static struct crtpLinkOperations *link = &nopLink;
 
+/* Packets are sent from one TX queue per class, so that a burst of telemetry
+ * does not delay the replies. The TX task serves the classes in a weighted
+ * round: each class can send up to its weight of packets per round, in the
+ * order of the classes, and a new round starts when no class with packets
+ * left has any credit left. A class alone with packets can use the whole
+ * link. */
+typedef enum {
+  crtpTxClassControl,       // Replies and everything not below
+  crtpTxClassLocalization,
+  crtpTxClassLog,           // Log data, the log replies are control
+  crtpTxClassConsole,
+  crtpTxClassCount
+} crtpTxClass_t;
+
+static const uint8_t txQueueSize[crtpTxClassCount] = {16, 16, 48, 20};
+static const uint8_t txWeight[crtpTxClassCount] = {8, 4, 2, 1};
+
+#define CRTP_LOG_DATA_CHANNEL 2
+
+typedef struct {
+  uint32_t timestamp;  // usecTimestamp() when the packet was queued
+  CRTPPacket packet;
+} crtpTxItem_t;
+
+// Wait before retrying on a link without ready callback
+#define CRTP_LINK_RETRY_MS 10
+
+/* Histogram of the time from queuing to the link, of all the classes. The
+ * first bucket is below CRTP_TX_DELAY_HIST_FIRST_US, each next one is twice as
+ * wide and the last one has all the longer delays. */
+#define CRTP_TX_DELAY_HIST_BUCKETS 6
+#define CRTP_TX_DELAY_HIST_FIRST_US 500
+
 #define STATS_INTERVAL 500
 static struct {
   uint32_t rxCount;
@@ -62,14 +103,28 @@ static struct {
   uint16_t rxRate;
   uint16_t txRate;
 
+  // Per class, packets dropped because the queue was full since start
+  uint32_t txDropped[crtpTxClassCount];
+  // Per class, time from queuing to the link over the last interval [us]
+  uint32_t txLatencyMean[crtpTxClassCount];
+  uint32_t txLatencyMax[crtpTxClassCount];
+  uint32_t txLatencySum[crtpTxClassCount];
+  uint32_t txLatencyMaxCurrent[crtpTxClassCount];
+  uint16_t txClassCount[crtpTxClassCount];
+
+  // Packets per delay since start
+  uint32_t txDelayHistogram[CRTP_TX_DELAY_HIST_BUCKETS];
+
   uint32_t nextStatisticsTime;
   uint32_t previousStatisticsTime;
 } stats;
 
-static xQueueHandle  txQueue;
+static xQueueHandle txQueues[crtpTxClassCount];
+static int8_t txCredit[crtpTxClassCount];
+static TaskHandle_t txTaskHandle;
+static xSemaphoreHandle linkReady;
 
 #define CRTP_NBR_OF_PORTS 16
-#define CRTP_TX_QUEUE_SIZE 100
 #define CRTP_RX_QUEUE_SIZE 16
 
 static void crtpTxTask(void *param);
@@ -84,11 +139,16 @@ void crtpInit(void)
   if(isInit)
     return;
 
-  txQueue = xQueueCreate(CRTP_TX_QUEUE_SIZE, sizeof(CRTPPacket));
-  DEBUG_QUEUE_MONITOR_REGISTER(txQueue);
+  for (int c = 0; c < crtpTxClassCount; c++)
+  {
+    txQueues[c] = xQueueCreate(txQueueSize[c], sizeof(crtpTxItem_t));
+    DEBUG_QUEUE_MONITOR_REGISTER(txQueues[c]);
+  }
+
+  vSemaphoreCreateBinary(linkReady);
 
   xTaskCreate(crtpTxTask, CRTP_TX_TASK_NAME,
-              CRTP_TX_TASK_STACKSIZE, NULL, CRTP_TX_TASK_PRI, NULL);
+              CRTP_TX_TASK_STACKSIZE, NULL, CRTP_TX_TASK_PRI, &txTaskHandle);
   xTaskCreate(crtpRxTask, CRTP_RX_TASK_NAME,
               CRTP_RX_TASK_STACKSIZE, NULL, CRTP_RX_TASK_PRI, NULL);
 
@@ -136,27 +196,97 @@ int crtpReceivePacketWait(CRTPPort portId, CRTPPacket *p, int wait)
   return xQueueReceive(queues[portId], p, M2T(wait));
 }
 
-int crtpGetFreeTxQueuePackets(void)
+static crtpTxClass_t crtpGetTxClass(uint8_t port, uint8_t channel)
 {
-  return (CRTP_TX_QUEUE_SIZE - uxQueueMessagesWaiting(txQueue));
+  switch (port)
+  {
+    case CRTP_PORT_CONSOLE:
+      return crtpTxClassConsole;
+    case CRTP_PORT_LOCALIZATION:
+      return crtpTxClassLocalization;
+    case CRTP_PORT_LOG:
+      return (channel == CRTP_LOG_DATA_CHANNEL) ? crtpTxClassLog : crtpTxClassControl;
+    default:
+      return crtpTxClassControl;
+  }
+}
+
+int crtpGetFreeTxQueuePackets(CRTPPort portId)
+{
+  crtpTxClass_t txClass = crtpGetTxClass(portId, CRTP_LOG_DATA_CHANNEL);
+
+  return (txQueueSize[txClass] - uxQueueMessagesWaiting(txQueues[txClass]));
+}
+
+// Returns the class to send from next, or -1 if all the queues are empty
+static int crtpTxSchedule(void)
+{
+  for (int round = 0; round < 2; round++)
+  {
+    for (int c = 0; c < crtpTxClassCount; c++)
+    {
+      if (txCredit[c] > 0 && uxQueueMessagesWaiting(txQueues[c]) > 0)
+      {
+        txCredit[c]--;
+        return c;
+      }
+    }
+
+    for (int c = 0; c < crtpTxClassCount; c++)
+    {
+      txCredit[c] = txWeight[c];
+    }
+  }
+
+  return -1;
 }
 
 void crtpTxTask(void *param)
 {
-  CRTPPacket p;
+  crtpTxItem_t item;
+  int txClass;
 
   while (true)
   {
     if (link != &nopLink)
     {
-      if (xQueueReceive(txQueue, &p, portMAX_DELAY) == pdTRUE)
+      txClass = crtpTxSchedule();
+      if (txClass < 0)
+      {
+        // Woken up by the senders
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      }
+      else if (xQueueReceive(txQueues[txClass], &item, 0) == pdTRUE)
       {
         // Keep testing, if the link changes to USB it will go though
-        while (link->sendPacket(&p) == false)
+        while (link->sendPacket(&item.packet) == false)
         {
-          // Relaxation time
-          vTaskDelay(M2T(10));
+          if (link->setReadyCallback)
+          {
+            // Woken up by the link as soon as it has room, or by a link change
+            xSemaphoreTake(linkReady, portMAX_DELAY);
+          }
+          else
+          {
+            // Relaxation time
+            vTaskDelay(M2T(CRTP_LINK_RETRY_MS));
+          }
         }
+
+        uint32_t latency = (uint32_t)usecTimestamp() - item.timestamp;
+        int bucket = 0;
+        for (uint32_t limit = CRTP_TX_DELAY_HIST_FIRST_US;
+             latency >= limit && bucket < CRTP_TX_DELAY_HIST_BUCKETS - 1; limit *= 2)
+        {
+          bucket++;
+        }
+        stats.txDelayHistogram[bucket]++;
+        stats.txLatencySum[txClass] += latency;
+        if (latency > stats.txLatencyMaxCurrent[txClass])
+        {
+          stats.txLatencyMaxCurrent[txClass] = latency;
+        }
+        stats.txClassCount[txClass]++;
         stats.txCount++;
         updateStats();
       }
@@ -211,25 +341,44 @@ void crtpRegisterPortCB(int port, CrtpCallback cb)
   callbacks[port] = cb;
 }
 
-int crtpSendPacket(CRTPPacket *p)
+static int crtpQueueTxPacket(CRTPPacket *p, TickType_t wait)
 {
-  ASSERT(p); 
+  crtpTxItem_t item;
+  crtpTxClass_t txClass;
+
+  ASSERT(p);
   ASSERT(p->size <= CRTP_MAX_DATA_SIZE);
 
-  return xQueueSend(txQueue, p, 0);
+  txClass = crtpGetTxClass(p->port, p->channel);
+  item.timestamp = (uint32_t)usecTimestamp();
+  memcpy(&item.packet, p, sizeof(item.packet));
+
+  if (xQueueSend(txQueues[txClass], &item, wait) != pdTRUE)
+  {
+    stats.txDropped[txClass]++;
+    return pdFALSE;
+  }
+
+  xTaskNotifyGive(txTaskHandle);
+  return pdTRUE;
 }
 
-int crtpSendPacketBlock(CRTPPacket *p)
+int crtpSendPacket(CRTPPacket *p)
 {
-  ASSERT(p); 
-  ASSERT(p->size <= CRTP_MAX_DATA_SIZE);
+  return crtpQueueTxPacket(p, 0);
+}
 
-  return xQueueSend(txQueue, p, portMAX_DELAY);
+int crtpSendPacketBlock(CRTPPacket *p)
+{
+  return crtpQueueTxPacket(p, portMAX_DELAY);
 }
 
 int crtpReset(void)
 {
-  xQueueReset(txQueue);
+  for (int c = 0; c < crtpTxClassCount; c++)
+  {
+    xQueueReset(txQueues[c]);
+  }
   if (link->reset) {
     link->reset();
   }
@@ -244,6 +393,23 @@ bool crtpIsConnected(void)
   return true;
 }
 
+// Called by the link when it has room again, from a task or an interrupt
+static void crtpLinkReady(void)
+{
+  bool isInInterrupt = (SCB->ICSR & SCB_ICSR_VECTACTIVE_Msk) != 0;
+
+  if (isInInterrupt)
+  {
+    portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
+    xSemaphoreGiveFromISR(linkReady, &xHigherPriorityTaskWoken);
+    portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+  }
+  else
+  {
+    xSemaphoreGive(linkReady);
+  }
+}
+
 void crtpSetLink(struct crtpLinkOperations * lk)
 {
   if(link)
@@ -254,7 +420,14 @@ void crtpSetLink(struct crtpLinkOperations * lk)
   else
     link = &nopLink;
 
+  if (link->setReadyCallback)
+    link->setReadyCallback(crtpLinkReady);
+
   link->setEnable(true);
+
+  // A packet refused by the old link can be tried on the new one right away
+  if (linkReady)
+    crtpLinkReady();
 }
 
 static int nopFunc(void)
@@ -276,6 +449,15 @@ static void updateStats()
     stats.rxRate = (uint16_t)(1000.0f * stats.rxCount / interval);
     stats.txRate = (uint16_t)(1000.0f * stats.txCount / interval);
 
+    for (int c = 0; c < crtpTxClassCount; c++)
+    {
+      stats.txLatencyMean[c] = stats.txClassCount[c] ? stats.txLatencySum[c] / stats.txClassCount[c] : 0;
+      stats.txLatencyMax[c] = stats.txLatencyMaxCurrent[c];
+      stats.txLatencySum[c] = 0;
+      stats.txLatencyMaxCurrent[c] = 0;
+      stats.txClassCount[c] = 0;
+    }
+
     clearStats();
     stats.previousStatisticsTime = now;
     stats.nextStatisticsTime = now + STATS_INTERVAL;
@@ -285,4 +467,10 @@ static void updateStats()
 LOG_GROUP_START(crtp)
 LOG_ADD(LOG_UINT16, rxRate, &stats.rxRate)
 LOG_ADD(LOG_UINT16, txRate, &stats.txRate)
+// Per class: control, localization, log and console
+LOG_ADD_ARRAY(LOG_UINT32, txDrop, &stats.txDropped, crtpTxClassCount)
+LOG_ADD_ARRAY(LOG_UINT32, txLatMean, &stats.txLatencyMean, crtpTxClassCount)
+LOG_ADD_ARRAY(LOG_UINT32, txLatMax, &stats.txLatencyMax, crtpTxClassCount)
+// Below 0.5, 1, 2, 4 and 8 ms, and the longer ones
+LOG_ADD_ARRAY(LOG_UINT32, txDelayHist, &stats.txDelayHistogram, CRTP_TX_DELAY_HIST_BUCKETS)
 LOG_GROUP_STOP(tdoa)
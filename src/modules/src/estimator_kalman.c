@@ -216,9 +216,6 @@ static inline float arm_sqrt(float32_t in)
 
 void estimatorKalman(state_t *state, sensorData_t *sensors, control_t *control, const uint32_t tick)
 {
-  // If the client (via a parameter update) triggers an estimator reset:
-  if (coreData.resetEstimation) { estimatorKalmanInit(); coreData.resetEstimation = false; }
-
   // Tracks whether an update to the state has been made, and the state therefore requires finalization
   bool doneUpdate = false;
 
@@ -418,6 +415,26 @@ void estimatorKalman(state_t *state, sensorData_t *sensors, control_t *control,
 
 
 
+// Called by the stabilizer loop when the client writes kalman.resetEstimation
+static void resetEstimationChanged(void)
+{
+  if (!coreData.resetEstimation) {
+    return;
+  }
+
+  if (isInit) {
+    // Clears resetEstimation
+    estimatorKalmanInit();
+  } else {
+    // Never run, it is reset when it is first used
+    coreData.resetEstimation = false;
+  }
+}
+
+void estimatorKalmanParamInit(void) {
+  paramAddCallback(paramGetVarId("kalman", "resetEstimation"), resetEstimationChanged);
+}
+
 void estimatorKalmanInit(void) {
   if (!isInit)
   {
@@ -0,0 +1,318 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie Firmware
+ *
+ * Copyright (C) 2019 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * flight_recorder.c: Records log variables at the rate of the stabilizer
+ *                    loop in RAM, around an incident
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#include "flight_recorder.h"
+#include "log.h"
+#include "crc.h"
+
+#define FLIGHT_RECORDER_VERSION 1
+#define FLIGHT_RECORDER_MAGIC 0x7a3c91e5
+#define FLIGHT_RECORDER_NO_TRIGGER 0xff
+// Offset of the configuration in the header
+#define FLIGHT_RECORDER_CONFIG_OFFSET 12
+
+typedef struct {
+  uint8_t version;
+  uint8_t state;
+  uint8_t reason;
+  uint8_t frameSize;
+  uint16_t frameCount;
+  uint16_t triggerFrame;
+  uint32_t triggerTime;
+  // Configuration
+  uint8_t triggerMask;
+  uint8_t divider;
+  uint8_t postPercent;
+  uint8_t varCount;
+  uint16_t varIds[FLIGHT_RECORDER_MAX_VARS];
+} __attribute__((packed)) flightRecorderHeader_t;
+
+typedef struct {
+  uint32_t magic;
+  crc headerCrc;  // Of a frozen header
+  flightRecorderHeader_t header;
+  uint16_t capacity;  // Frames in the buffer
+  uint16_t head;      // Next frame to write
+  uint32_t written;
+  uint32_t writtenAtTrigger;
+  uint16_t postRemaining;
+  uint8_t buffer[FLIGHT_RECORDER_BUFFER_SIZE];
+} flightRecorder_t;
+
+// The .nzds section is not cleared at startup, a frozen window survives a
+// reset by the watchdog
+static flightRecorder_t recorder __attribute__((section(".nzds")));
+
+// Resolved at arm time, the stabilizer loop only copies bytes
+static const void* varAddress[FLIGHT_RECORDER_MAX_VARS];
+static uint8_t varSize[FLIGHT_RECORDER_MAX_VARS];
+static uint8_t ticksToSample;
+static volatile uint8_t pendingTrigger = FLIGHT_RECORDER_NO_TRIGGER;
+static bool isInit = false;
+
+static bool isFrozenWindowValid(void)
+{
+  const flightRecorderHeader_t* h = &recorder.header;
+
+  return recorder.magic == FLIGHT_RECORDER_MAGIC &&
+    recorder.headerCrc == crcSlow(&recorder.header, sizeof(recorder.header)) &&
+    h->version == FLIGHT_RECORDER_VERSION &&
+    h->state == flightRecorderStateFrozen &&
+    h->frameSize > 0 &&
+    recorder.capacity * h->frameSize <= FLIGHT_RECORDER_BUFFER_SIZE &&
+    h->frameCount <= recorder.capacity &&
+    recorder.head < recorder.capacity;
+}
+
+void flightRecorderInit(void)
+{
+  if (isInit) {
+    return;
+  }
+
+  if (!isFrozenWindowValid()) {
+    memset(&recorder.header, 0, sizeof(recorder.header));
+    recorder.header.version = FLIGHT_RECORDER_VERSION;
+    recorder.header.state = flightRecorderStateOff;
+    recorder.header.triggerMask = 0xff;
+    recorder.header.divider = 1;
+    recorder.header.postPercent = 20;
+    recorder.magic = FLIGHT_RECORDER_MAGIC;
+  }
+
+  isInit = true;
+}
+
+static void freeze(void)
+{
+  flightRecorderHeader_t* h = &recorder.header;
+  uint32_t count = recorder.written < recorder.capacity ? recorder.written : recorder.capacity;
+  uint32_t first = recorder.written - count;
+
+  h->frameCount = count;
+  h->triggerFrame = recorder.writtenAtTrigger > first ? recorder.writtenAtTrigger - 1 - first : 0;
+  h->state = flightRecorderStateFrozen;
+  recorder.headerCrc = crcSlow(h, sizeof(*h));
+}
+
+void flightRecorderUpdate(uint32_t tick)
+{
+  flightRecorderHeader_t* h = &recorder.header;
+
+  if (h->state != flightRecorderStateRecording && h->state != flightRecorderStateTriggered) {
+    return;
+  }
+
+  if (--ticksToSample > 0) {
+    return;
+  }
+  ticksToSample = h->divider;
+
+  uint8_t* frame = &recorder.buffer[recorder.head * h->frameSize];
+  memcpy(frame, &tick, sizeof(tick));
+  frame += sizeof(tick);
+  for (int i = 0; i < h->varCount; i++) {
+    memcpy(frame, varAddress[i], varSize[i]);
+    frame += varSize[i];
+  }
+
+  recorder.head++;
+  if (recorder.head >= recorder.capacity) {
+    recorder.head = 0;
+  }
+  recorder.written++;
+
+  if (h->state == flightRecorderStateRecording) {
+    uint8_t trigger = pendingTrigger;
+    if (trigger != FLIGHT_RECORDER_NO_TRIGGER) {
+      h->state = flightRecorderStateTriggered;
+      h->reason = trigger;
+      h->triggerTime = tick;
+      recorder.writtenAtTrigger = recorder.written;
+      recorder.postRemaining = (uint32_t)(recorder.capacity - 1) * h->postPercent / 100;
+    }
+  } else if (recorder.postRemaining > 0) {
+    recorder.postRemaining--;
+  }
+
+  if (h->state == flightRecorderStateTriggered && recorder.postRemaining == 0) {
+    freeze();
+  }
+}
+
+void flightRecorderTrigger(flightRecorderTrigger_t trigger)
+{
+  // The first trigger wins, the window is recorded around it
+  if (pendingTrigger == FLIGHT_RECORDER_NO_TRIGGER && (recorder.header.triggerMask & (1 << trigger))) {
+    pendingTrigger = trigger;
+  }
+}
+
+void flightRecorderFreeze(flightRecorderTrigger_t trigger)
+{
+  flightRecorderHeader_t* h = &recorder.header;
+
+  if (!isInit || !(h->triggerMask & (1 << trigger))) {
+    return;
+  }
+
+  if (h->state == flightRecorderStateRecording) {
+    h->reason = trigger;
+    h->triggerTime = 0;
+    if (recorder.written > 0) {
+      uint32_t last = recorder.head > 0 ? recorder.head - 1 : recorder.capacity - 1;
+      memcpy(&h->triggerTime, &recorder.buffer[last * h->frameSize], sizeof(h->triggerTime));
+    }
+    recorder.writtenAtTrigger = recorder.written;
+    freeze();
+  } else if (h->state == flightRecorderStateTriggered) {
+    // Keep the first trigger, the post trigger part is cut short
+    freeze();
+  }
+}
+
+static bool arm(void)
+{
+  flightRecorderHeader_t* h = &recorder.header;
+  int frameSize = sizeof(uint32_t);
+
+  if (h->varCount > FLIGHT_RECORDER_MAX_VARS || h->divider == 0 || h->postPercent > 100) {
+    return false;
+  }
+
+  for (int i = 0; i < h->varCount; i++) {
+    int varid = logGetVarIdFromToc(h->varIds[i]);
+    if (varid < 0) {
+      return false;
+    }
+    varAddress[i] = logGetAddress(varid);
+    varSize[i] = logVarSize(logGetType(varid));
+    frameSize += varSize[i];
+  }
+
+  h->frameSize = frameSize;
+  h->frameCount = 0;
+  h->triggerFrame = 0;
+  h->triggerTime = 0;
+  h->reason = 0;
+  recorder.capacity = FLIGHT_RECORDER_BUFFER_SIZE / frameSize;
+  recorder.head = 0;
+  recorder.written = 0;
+  recorder.writtenAtTrigger = 0;
+  recorder.postRemaining = 0;
+  ticksToSample = 1;
+  pendingTrigger = FLIGHT_RECORDER_NO_TRIGGER;
+
+  // Last, the stabilizer may start sampling as soon as the state is set
+  h->state = flightRecorderStateRecording;
+  return true;
+}
+
+uint32_t flightRecorderMemSize(void)
+{
+  return FLIGHT_RECORDER_HEADER_SIZE + FLIGHT_RECORDER_BUFFER_SIZE;
+}
+
+bool flightRecorderMemRead(uint32_t offset, uint8_t length, uint8_t* dest)
+{
+  const flightRecorderHeader_t* h = &recorder.header;
+
+  if (!isInit) {
+    return false;
+  }
+
+  // Header
+  while (length > 0 && offset < FLIGHT_RECORDER_HEADER_SIZE) {
+    *dest++ = ((const uint8_t*)h)[offset++];
+    length--;
+  }
+
+  if (length == 0) {
+    return true;
+  }
+
+  // Frames, only stable once frozen
+  uint32_t dataOffset = offset - FLIGHT_RECORDER_HEADER_SIZE;
+  if (h->state != flightRecorderStateFrozen ||
+      dataOffset + length > (uint32_t)h->frameCount * h->frameSize) {
+    return false;
+  }
+
+  uint32_t first = (recorder.head + recorder.capacity - h->frameCount) % recorder.capacity;
+  while (length > 0) {
+    uint32_t frame = dataOffset / h->frameSize;
+    uint32_t inFrame = dataOffset % h->frameSize;
+    uint32_t chunk = h->frameSize - inFrame;
+    if (chunk > length) {
+      chunk = length;
+    }
+
+    uint32_t slot = (first + frame) % recorder.capacity;
+    memcpy(dest, &recorder.buffer[slot * h->frameSize + inFrame], chunk);
+
+    dest += chunk;
+    dataOffset += chunk;
+    length -= chunk;
+  }
+
+  return true;
+}
+
+bool flightRecorderMemWrite(uint32_t offset, uint8_t length, const uint8_t* src)
+{
+  flightRecorderHeader_t* h = &recorder.header;
+
+  if (!isInit) {
+    return false;
+  }
+
+  // Arm or stop
+  if (offset == offsetof(flightRecorderHeader_t, state) && length == 1) {
+    switch (src[0]) {
+      case flightRecorderStateOff:
+        h->state = flightRecorderStateOff;
+        return true;
+      case flightRecorderStateRecording:
+        h->state = flightRecorderStateOff;
+        return arm();
+      default:
+        return false;
+    }
+  }
+
+  // Configuration
+  if (h->state == flightRecorderStateOff &&
+      offset >= FLIGHT_RECORDER_CONFIG_OFFSET && offset + length <= FLIGHT_RECORDER_HEADER_SIZE) {
+    memcpy((uint8_t*)h + offset, src, length);
+    return true;
+  }
+
+  return false;
+}
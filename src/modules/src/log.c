@@ -29,21 +29,23 @@
 
 #include <string.h>
 #include <errno.h>
+#include <math.h>
 #include <stdint.h>
 #include <stdbool.h>
 
 /* FreeRtos includes */
 #include "FreeRTOS.h"
 #include "task.h"
-#include "timers.h"
 #include "semphr.h"
 
 #include "config.h"
 #include "crtp.h"
 #include "log.h"
 #include "crc.h"
-#include "worker.h"
 #include "num.h"
+#include "toc_index.h"
+#include "trigger.h"
+#include "usec_time.h"
 
 #include "console.h"
 #include "cfassert.h"
@@ -72,25 +74,182 @@ static const uint8_t typeLength[] = {
 // Maximum log payload length (4 bytes are used for block id and timestamp)
 #define LOG_MAX_LEN 26
 
-/* Log packet parameters storage */
+/* Log packet parameters storage. The limits can be set per platform, see
+ * tools/make/platforms. The client is told about at most 255 of each. */
+#ifndef LOG_MAX_OPS
 #define LOG_MAX_OPS 128
+#endif
+#ifndef LOG_MAX_BLOCKS
 #define LOG_MAX_BLOCKS 16
+#endif
+#define LOG_MAX_QUANTIZATIONS 32
+#define LOG_MAX_AGGREGATIONS 16
+#define LOG_INFO_MAX(n) ((n) < 255 ? (n) : 255)
+
+/* Ops and blocks are allocated from fixed size pools. Free items are kept in
+ * a list, linked through the next pointer of the ops and the nextFree
+ * pointer of the blocks. */
 struct log_ops {
-  struct log_ops * next;
+  struct log_ops * next;  // Next op in the block, or next free op
+  uint8_t storageType : 4;
+  uint8_t logType     : 4;
+  uint8_t quantization;  // Index + 1 in logQuantizations, 0 if not quantized
+  uint8_t aggregation;   // Index + 1 in logAggregations, 0 if not aggregated
+  uint8_t count;         // Number of elements, more than 1 for array slices
+  void * variable;       // First element
+};
+
+/* Quantization of a variable to an 8 or 16 bit integer,
+ * logged value = round((value - offset) / scale) */
+struct log_quantization {
+  float invScale;  // 0 if the quantization is free
+  float offset;
+};
+
+/* Aggregated variables are sampled by the stabilizer loop, every divider
+ * ticks, through logAggregationUpdate(). The block sends the mean, min or max
+ * of the samples taken since it was last sent, as a float that is converted
+ * to the log type like any other variable. */
+enum log_aggregation_mode {
+  LOG_AGGREGATION_NONE,
+  LOG_AGGREGATION_MEAN,
+  LOG_AGGREGATION_MIN,
+  LOG_AGGREGATION_MAX,
+};
+
+struct log_aggregation {
+  uint8_t mode;        // LOG_AGGREGATION_NONE if the aggregation is free
+  uint8_t divider;
+  uint8_t ticksToSample;
+  uint16_t count;
+  float accumulator;   // Sum, min or max of the samples
+  float result;        // Sent by the block
+};
+
+/* Encoded blocks start with a frame header after the timestamp. Bit 7 is set
+ * for delta frames and bits 0-6 hold a sequence number, that lets the client
+ * detect lost frames and wait for the next keyframe.
+ * In delta frames integer variables are sent as the difference to the last
+ * frame, modulo the size of the type, in one byte. Float variables are always
+ * sent as they are. A keyframe is sent every keyframeInterval frames, or when
+ * a difference does not fit in a byte. */
+#define LOG_ENCODED_DELTA_FRAME 0x80
+#define LOG_ENCODED_SEQUENCE_MASK 0x7F
+
+/* Packets are stamped with the time the variables are sampled. By default
+ * the timestamp is the system tick in ms, 3 bytes after the block id.
+ * Blocks can use the microsecond timer instead, the timestamp is then the
+ * low 4 bytes of usecTimestamp() and wraps every 71 minutes. In encoded
+ * microsecond blocks the frame header follows the block id, keyframes carry
+ * the full timestamp and delta frames the difference to the timestamp of
+ * the last frame in 2 bytes, computed modulo 2^32 so that it is right
+ * across a wrap. A keyframe is sent when the difference does not fit. */
+enum log_timestamp_mode {
+  LOG_TIMESTAMP_MS,
+  LOG_TIMESTAMP_USEC,
+};
+
+/* Blocks are compiled to programs of copy and convert operations when they
+ * are changed, so that running a block does not have to decode its ops list.
+ * The programs of all blocks are stored after each other in logProgram.
+ * Array slices are compiled element by element, the elements of a slice that
+ * is sent as it is stored are merged into one copy. */
+enum log_program_kind {
+  LOG_PROGRAM_COPY,     // Copy variables with the same storage and log type
+  LOG_PROGRAM_HALF,     // Convert a float to a half precision float
+  LOG_PROGRAM_QUANTIZE, // Quantize a variable to an integer
+  LOG_PROGRAM_CONVERT,  // Any other conversion
+};
+
+struct log_program_op {
+  const void * source;
+  uint8_t kind;
+  uint8_t offset;  // Destination offset in the packet data
+  union {
+    uint8_t length;        // Copy: number of bytes to copy
+    uint8_t quantization;  // Quantize: index in logQuantizations
+  };
   uint8_t storageType : 4;
   uint8_t logType     : 4;
-  void * variable;
+};
+
+/* The blocks are run by one scheduler task. Started blocks are kept in a
+ * hashed time wheel with one slot per tick, a block is in the slot of the
+ * tick it is due modulo the size of the wheel. */
+#define LOG_WHEEL_SLOTS 64
+#define LOG_WHEEL_MASK (LOG_WHEEL_SLOTS - 1)
+// Free log TX queue packets, samples are skipped rather than dropped below this
+#define LOG_MIN_FREE_TX_PACKETS 10
+
+/* Triggered blocks are polled at the period they are started with, and are
+ * only sent when a condition on one TOC variable fires: when it has changed
+ * by threshold since it was last sent, or when it has been below or above
+ * threshold for count polls in a row (see trigger.c). Sending is limited to
+ * once every minInterval, a condition that fires in between is sent when the
+ * interval has passed. */
+enum log_trigger_mode {
+  LOG_TRIGGER_NONE,    // Sent at every run
+  LOG_TRIGGER_CHANGE,  // Sent when the variable has changed by threshold
+  LOG_TRIGGER_LE,      // Sent once the variable is below or at threshold
+  LOG_TRIGGER_GE,      // Sent once the variable is above or at threshold
+};
+
+struct log_trigger {
+  uint8_t mode;
+  bool pending;
+  int varIndex;        // Index in logs
+  float lastValue;     // Change mode: value when the block was last sent
+  TickType_t minInterval;
+  TickType_t lastSent;
+  trigger_t trigger;   // Threshold modes
 };
 
 struct log_block {
   int id;
-  xTimerHandle timer;
   struct log_ops * ops;
+  // Scheduling
+  bool isStarted;
+  TickType_t period;      // 0 for single shot runs
+  TickType_t due;
+  struct log_block * wheelNext;
+  uint16_t skipped;       // Samples skipped since the block was started
+  struct log_block * nextFree;
+  uint16_t programStart;
+  uint8_t programLength;
+  uint8_t size;  // Size of the packet data, including block id and timestamp
+  // Encoding, keyframeInterval is 0 for blocks that are sent as they are
+  uint8_t keyframeInterval;
+  uint8_t framesToKeyframe;
+  uint8_t sequence;
+  uint8_t lastFrame[LOG_MAX_LEN];
+  uint8_t timestampMode;
+  uint32_t lastTimestamp;    // Encoded microsecond blocks: of the last frame
+  struct log_trigger trigger;
+  uint16_t aggregationMask;  // Aggregations used by the block
 };
 
 static struct log_ops logOps[LOG_MAX_OPS];
+static struct log_quantization logQuantizations[LOG_MAX_QUANTIZATIONS];
+static struct log_aggregation logAggregations[LOG_MAX_AGGREGATIONS];
+// How the aggregated variables are loaded, only used by the stabilizer loop
+static struct log_program_op logAggregationLoads[LOG_MAX_AGGREGATIONS];
+// Every logged element is compiled to at most one program operation
+static struct log_program_op logProgram[LOG_MAX_OPS];
 static struct log_block logBlocks[LOG_MAX_BLOCKS];
+static struct log_ops * opsFreeList;
+static struct log_block * blocksFreeList;
+// Pool usage, the high-water marks are kept until reboot
+static uint16_t opsUsed;
+static uint16_t opsHighWater;
+// Elements logged by all the ops, limited by the size of logProgram
+static uint16_t logElements;
+static uint8_t blocksUsed;
+static uint8_t blocksHighWater;
+static struct log_block * logWheel[LOG_WHEEL_SLOTS];
+static TickType_t logWheelTick;
 static xSemaphoreHandle logLock;
+static TaskHandle_t logSchedulerHandle;
+static uint32_t logSkippedTotal;
 
 struct ops_setting {
     uint8_t logType;
@@ -102,6 +261,13 @@ struct ops_setting_v2 {
     uint16_t id;
 } __attribute__((packed));
 
+struct ops_setting_slice {
+    uint8_t logType;
+    uint16_t id;
+    uint8_t first;
+    uint8_t count;
+} __attribute__((packed));
+
 
 #define TOC_CH      0
 #define CONTROL_CH  1
@@ -120,6 +286,13 @@ struct ops_setting_v2 {
 #define CONTROL_RESET           5
 #define CONTROL_CREATE_BLOCK_V2 6
 #define CONTROL_APPEND_BLOCK_V2 7
+#define CONTROL_SET_ENCODING    8
+#define CONTROL_SET_QUANTIZATION 9
+#define CONTROL_GET_BLOCK_STATS 10
+#define CONTROL_SET_TRIGGER     11
+#define CONTROL_SET_AGGREGATION 12
+#define CONTROL_APPEND_BLOCK_SLICE 13
+#define CONTROL_SET_TIMESTAMP   14
 
 #define BLOCK_ID_FREE -1
 
@@ -127,9 +300,8 @@ struct ops_setting_v2 {
 static void logTask(void * prm);
 static void logTOCProcess(int command);
 static void logControlProcess(void);
-
-void logRunBlock(void * arg);
-void logBlockTimed(xTimerHandle timer);
+static void logSchedulerTask(void * prm);
+static bool logRunBlock(struct log_block * blk);
 
 //These are set by the Linker
 extern struct log_s _log_start;
@@ -140,6 +312,7 @@ static struct log_s * logs;
 static int logsLen;
 static uint32_t logsCrc;
 static uint16_t logsCount = 0;
+static tocIndex_t logsIndex;
 
 static CRTPPacket p;
 
@@ -148,12 +321,41 @@ static bool isInit = false;
 /* Log management functions */
 static int logAppendBlock(int id, struct ops_setting * settings, int len);
 static int logAppendBlockV2(int id, struct ops_setting_v2 * settings, int len);
+static int logAppendBlockSlice(int id, struct ops_setting_slice * settings, int len);
 static int logCreateBlock(unsigned char id, struct ops_setting * settings, int len);
 static int logCreateBlockV2(unsigned char id, struct ops_setting_v2 * settings, int len);
 static int logDeleteBlock(int id);
 static int logStartBlock(int id, unsigned int period);
 static int logStopBlock(int id);
+static int logSetEncoding(int id, uint8_t keyframeInterval);
+static int logSetTimestamp(int id, uint8_t mode);
+static int logSetQuantization(int id, int index, float scale, float offset);
+static int logGetBlockStats(int id, uint16_t * skipped);
+static int logSetTrigger(int id, uint8_t mode, uint16_t varId, float threshold,
+                         uint8_t count, unsigned int minInterval);
+static int logSetAggregation(int id, int index, uint8_t mode, uint8_t divider);
 static void logReset();
+static void logCompilePrograms();
+
+// The type in the TOC image and CRC, arrays are flagged. The item replies
+// list arrays as single variables of their first element, as older clients
+// do not know the flag.
+static uint8_t logGetTocType(int i)
+{
+  return logs[i].count ? (logs[i].type | LOG_ARRAY) : logs[i].type;
+}
+
+static void logGetTocEntry(int i, tocEntry_t* entry)
+{
+  if (logs[i].type & LOG_GROUP) {
+    entry->kind = (logs[i].type & LOG_START) ? tocEntryGroupStart : tocEntryGroupStop;
+  } else {
+    entry->kind = tocEntryVariable;
+  }
+  entry->type = logGetTocType(i);
+  entry->name = logs[i].name;
+  entry->count = logs[i].count;
+}
 
 void logInit(void)
 {
@@ -174,7 +376,7 @@ void logInit(void)
   {
     int len = 5;
     memcpy(&p.data[0], &logsCrc, 4);
-    p.data[4] = logs[i].type;
+    p.data[4] = logGetTocType(i);
     if (logs[i].type & LOG_GROUP) {
       if (logs[i].type & LOG_START) {
         group = logs[i].name;
@@ -191,17 +393,20 @@ void logInit(void)
       memcpy(&p.data[5], logs[i].name, strlen(logs[i].name));
       len += strlen(logs[i].name);
     }
+    if (logs[i].count) {
+      p.data[len++] = logs[i].count;
+    }
     logsCrc = crcSlow(p.data, len);
   }
 
   // Big lock that protects the log datastructures
   logLock = xSemaphoreCreateMutex();
 
-  for (i=0; i<logsLen; i++)
-  {
-    if(!(logs[i].type & LOG_GROUP))
-      logsCount++;
-  }
+  // Index the toc once, all lookups by id and name use the index
+  logsCount = tocIndexCountVariables(logsLen, logGetTocEntry);
+  uint16_t* indexStorage = pvPortMalloc(TOC_INDEX_STORAGE_SIZE(logsCount) * sizeof(uint16_t));
+  ASSERT(indexStorage);
+  tocIndexInit(&logsIndex, logsLen, logGetTocEntry, indexStorage);
 
   //Manually free all log blocks
   for(i=0; i<LOG_MAX_BLOCKS; i++)
@@ -213,6 +418,8 @@ void logInit(void)
   //Start the log task
   xTaskCreate(logTask, LOG_TASK_NAME,
               LOG_TASK_STACKSIZE, NULL, LOG_TASK_PRI, NULL);
+  xTaskCreate(logSchedulerTask, LOG_SCHEDULER_TASK_NAME,
+              LOG_SCHEDULER_TASK_STACKSIZE, NULL, LOG_SCHEDULER_TASK_PRI, &logSchedulerHandle);
 
   isInit = true;
 }
@@ -261,31 +468,18 @@ void logTOCProcess(int command)
       p.data[1]=255;
     }
     memcpy(&p.data[2], &logsCrc, 4);
-    p.data[6]=LOG_MAX_BLOCKS;
-    p.data[7]=LOG_MAX_OPS;
+    p.data[6]=LOG_INFO_MAX(LOG_MAX_BLOCKS);
+    p.data[7]=LOG_INFO_MAX(LOG_MAX_OPS);
     crtpSendPacket(&p);
     break;
   case CMD_GET_ITEM:  //Get log variable
     LOG_DEBUG("Packet is TOC_GET_ITEM Id: %d\n", p.data[1]);
-    for (ptr=0; ptr<logsLen; ptr++) //Ptr points a group
-    {
-      if (logs[ptr].type & LOG_GROUP)
-      {
-        if (logs[ptr].type & LOG_START)
-          group = logs[ptr].name;
-        else
-          group = "";
-      }
-      else                          //Ptr points a variable
-      {
-        if (n==p.data[1])
-          break;
-        n++;
-      }
-    }
+    n = p.data[1];
+    ptr = tocIndexGetEntry(&logsIndex, n);
 
-    if (ptr<logsLen)
+    if (ptr >= 0)
     {
+      group = logs[tocIndexGetGroup(&logsIndex, n)].name;
       LOG_DEBUG("    Item is \"%s\":\"%s\"\n", group, logs[ptr].name);
       p.header=CRTP_HEADER(CRTP_PORT_LOG, TOC_CH);
       p.data[0]=CMD_GET_ITEM;
@@ -313,32 +507,18 @@ void logTOCProcess(int command)
     p.data[0]=CMD_GET_INFO_V2;
     memcpy(&p.data[1], &logsCount, 2);
     memcpy(&p.data[3], &logsCrc, 4);
-    p.data[7]=LOG_MAX_BLOCKS;
-    p.data[8]=LOG_MAX_OPS;
+    p.data[7]=LOG_INFO_MAX(LOG_MAX_BLOCKS);
+    p.data[8]=LOG_INFO_MAX(LOG_MAX_OPS);
     crtpSendPacket(&p);
     break;
   case CMD_GET_ITEM_V2:  //Get log variable
     memcpy(&logId, &p.data[1], 2);
     LOG_DEBUG("Packet is TOC_GET_ITEM Id: %d\n", logId);
-    for (ptr=0; ptr<logsLen; ptr++) //Ptr points a group
-    {
-      if (logs[ptr].type & LOG_GROUP)
-      {
-        if (logs[ptr].type & LOG_START)
-          group = logs[ptr].name;
-        else
-          group = "";
-      }
-      else                          //Ptr points a variable
-      {
-        if (n==logId)
-          break;
-        n++;
-      }
-    }
+    ptr = tocIndexGetEntry(&logsIndex, logId);
 
-    if (ptr<logsLen)
+    if (ptr >= 0)
     {
+      group = logs[tocIndexGetGroup(&logsIndex, logId)].name;
       LOG_DEBUG("    Item is \"%s\":\"%s\"\n", group, logs[ptr].name);
       p.header=CRTP_HEADER(CRTP_PORT_LOG, TOC_CH);
       p.data[0]=CMD_GET_ITEM_V2;
@@ -363,6 +543,8 @@ void logTOCProcess(int command)
 void logControlProcess()
 {
   int ret = ENOEXEC;
+  uint16_t skipped = 0;
+  int elementsBefore = logElements;
 
   switch(p.data[0])
   {
@@ -399,14 +581,115 @@ void logControlProcess()
                             (struct ops_setting_v2*)&p.data[2],
                             (p.size-2)/sizeof(struct ops_setting_v2) );
       break;
+    case CONTROL_SET_ENCODING:
+      ret = logSetEncoding(p.data[1], p.data[2]);
+      break;
+    case CONTROL_SET_QUANTIZATION:
+    {
+      float scale, offset;
+      memcpy(&scale, &p.data[3], sizeof(scale));
+      memcpy(&offset, &p.data[7], sizeof(offset));
+      ret = logSetQuantization(p.data[1], p.data[2], scale, offset);
+      break;
+    }
+    case CONTROL_GET_BLOCK_STATS:
+      ret = logGetBlockStats(p.data[1], &skipped);
+      break;
+    case CONTROL_SET_TRIGGER:
+    {
+      // [id][mode][variable id, 2 bytes][threshold, float][count][min interval, 10 ms]
+      uint16_t varId;
+      float threshold;
+      memcpy(&varId, &p.data[3], sizeof(varId));
+      memcpy(&threshold, &p.data[5], sizeof(threshold));
+      ret = logSetTrigger(p.data[1], p.data[2], varId, threshold, p.data[9], p.data[10]*10);
+      break;
+    }
+    case CONTROL_SET_AGGREGATION:
+      ret = logSetAggregation(p.data[1], p.data[2], p.data[3], p.data[4]);
+      break;
+    case CONTROL_APPEND_BLOCK_SLICE:
+      ret = logAppendBlockSlice( p.data[1],
+                            (struct ops_setting_slice*)&p.data[2],
+                            (p.size-2)/sizeof(struct ops_setting_slice) );
+      break;
+    case CONTROL_SET_TIMESTAMP:
+      ret = logSetTimestamp(p.data[1], p.data[2]);
+      break;
+  }
+
+  // Commands that change the layout or the start of a block, the reset
+  // compiles the programs itself. Appends that fail part way have changed
+  // the block as well.
+  bool isBlockChanged = (logElements != elementsBefore);
+  switch(p.data[0])
+  {
+    case CONTROL_CREATE_BLOCK:
+    case CONTROL_APPEND_BLOCK:
+    case CONTROL_DELETE_BLOCK:
+    case CONTROL_START_BLOCK:
+    case CONTROL_CREATE_BLOCK_V2:
+    case CONTROL_APPEND_BLOCK_V2:
+    case CONTROL_SET_ENCODING:
+    case CONTROL_SET_QUANTIZATION:
+    case CONTROL_SET_AGGREGATION:
+    case CONTROL_APPEND_BLOCK_SLICE:
+    case CONTROL_SET_TIMESTAMP:
+      isBlockChanged |= (ret == 0);
+      break;
+  }
+
+  if (isBlockChanged)
+  {
+    logCompilePrograms();
+
+    // Encoded frames of a changed block can not be decoded against the old
+    // layout, so the block restarts with a keyframe
+    for (int i=0; i<LOG_MAX_BLOCKS; i++)
+      if (logBlocks[i].id == p.data[1])
+        logBlocks[i].framesToKeyframe = 0;
   }
 
   //Commands answer
   p.data[2] = ret;
   p.size = 3;
+  if (p.data[0] == CONTROL_GET_BLOCK_STATS && ret == 0)
+  {
+    memcpy(&p.data[3], &skipped, sizeof(skipped));
+    p.size += sizeof(skipped);
+  }
   crtpSendPacket(&p);
 }
 
+static struct log_block * blockMalloc(unsigned char id)
+{
+  struct log_block * block = blocksFreeList;
+
+  if (!block)
+    return NULL;
+
+  blocksFreeList = block->nextFree;
+  if (++blocksUsed > blocksHighWater)
+    blocksHighWater = blocksUsed;
+
+  block->id = id;
+  block->ops = NULL;
+  block->isStarted = false;
+  block->keyframeInterval = 0;
+  block->timestampMode = LOG_TIMESTAMP_MS;
+  block->trigger.mode = LOG_TRIGGER_NONE;
+
+  return block;
+}
+
+static void blockFree(struct log_block * block)
+{
+  block->id = BLOCK_ID_FREE;
+  block->nextFree = blocksFreeList;
+  blocksFreeList = block;
+  blocksUsed--;
+}
+
 static int logCreateBlock(unsigned char id, struct ops_setting * settings, int len)
 {
   int i;
@@ -414,23 +697,9 @@ static int logCreateBlock(unsigned char id, struct ops_setting * settings, int l
   for (i=0; i<LOG_MAX_BLOCKS; i++)
     if (id == logBlocks[i].id) return EEXIST;
 
-  for (i=0; i<LOG_MAX_BLOCKS; i++)
-    if (logBlocks[i].id == BLOCK_ID_FREE) break;
-
-  if (i == LOG_MAX_BLOCKS)
+  if (!blockMalloc(id))
     return ENOMEM;
 
-  logBlocks[i].id = id;
-  logBlocks[i].timer = xTimerCreate( "logTimer", M2T(1000),
-                                     pdTRUE, &logBlocks[i], logBlockTimed );
-  logBlocks[i].ops = NULL;
-
-  if (logBlocks[i].timer == NULL)
-  {
-	logBlocks[i].id = BLOCK_ID_FREE;
-	return ENOMEM;
-  }
-
   LOG_DEBUG("Added block ID %d\n", id);
 
   return logAppendBlock(id, settings, len);
@@ -443,34 +712,62 @@ static int logCreateBlockV2(unsigned char id, struct ops_setting_v2 * settings,
   for (i=0; i<LOG_MAX_BLOCKS; i++)
     if (id == logBlocks[i].id) return EEXIST;
 
-  for (i=0; i<LOG_MAX_BLOCKS; i++)
-    if (logBlocks[i].id == BLOCK_ID_FREE) break;
-
-  if (i == LOG_MAX_BLOCKS)
+  if (!blockMalloc(id))
     return ENOMEM;
 
-  logBlocks[i].id = id;
-  logBlocks[i].timer = xTimerCreate( "logTimer", M2T(1000),
-                                     pdTRUE, &logBlocks[i], logBlockTimed );
-  logBlocks[i].ops = NULL;
-
-  if (logBlocks[i].timer == NULL)
-  {
-  logBlocks[i].id = BLOCK_ID_FREE;
-  return ENOMEM;
-  }
-
   LOG_DEBUG("Added block ID %d\n", id);
 
   return logAppendBlockV2(id, settings, len);
 }
 
 static int blockCalcLength(struct log_block * block);
+static int blockHeaderSize(struct log_block * block);
+static int blockMaxLength(struct log_block * block);
 static struct log_ops * opsMalloc();
 static void opsFree(struct log_ops * ops);
 static void blockAppendOps(struct log_block * block, struct log_ops * ops);
 static int variableGetIndex(int id);
 
+/* Append count elements of a variable to a block */
+static int blockAppend(struct log_block * block, void * variable,
+                       uint8_t storageType, uint8_t logType, int count)
+{
+  struct log_ops * ops;
+
+  if (logType == 0 || logType > LOG_FP16 || storageType == 0 || storageType > LOG_FLOAT) {
+    return EINVAL;
+  }
+
+  if ((blockCalcLength(block) + typeLength[logType] * count) > blockMaxLength(block)) {
+    LOG_ERROR("Trying to append a full block. Block id %d.\n", block->id);
+    return E2BIG;
+  }
+
+  if (logElements + count > LOG_MAX_OPS) {
+    LOG_ERROR("No more ops memory free!\n");
+    return ENOMEM;
+  }
+
+  ops = opsMalloc();
+
+  if(!ops) {
+    LOG_ERROR("No more ops memory free!\n");
+    return ENOMEM;
+  }
+
+  ops->variable    = variable;
+  ops->storageType = storageType;
+  ops->logType     = logType;
+  ops->count       = count;
+  ops->quantization = 0;
+  ops->aggregation = 0;
+  logElements += count;
+
+  blockAppendOps(block, ops);
+
+  return 0;
+}
+
 static int logAppendBlock(int id, struct ops_setting * settings, int len)
 {
   int i;
@@ -490,21 +787,8 @@ static int logAppendBlock(int id, struct ops_setting * settings, int len)
 
   for (i=0; i<len; i++)
   {
-    int currentLength = blockCalcLength(block);
-    struct log_ops * ops;
     int varId;
-
-    if ((currentLength + typeLength[settings[i].logType&0x0F])>LOG_MAX_LEN) {
-      LOG_ERROR("Trying to append a full block. Block id %d.\n", id);
-      return E2BIG;
-    }
-
-    ops = opsMalloc();
-
-    if(!ops) {
-      LOG_ERROR("No more ops memory free!\n");
-      return ENOMEM;
-    }
+    int ret;
 
     if (settings[i].id != 255)  //TOC variable
     {
@@ -515,21 +799,23 @@ static int logAppendBlock(int id, struct ops_setting * settings, int len)
         return ENOENT;
       }
 
-      ops->variable    = logs[varId].address;
-      ops->storageType = logs[varId].type;
-      ops->logType     = settings[i].logType&0x0F;
+      // The first element of arrays, as listed in the item replies
+      ret = blockAppend(block, logs[varId].address, logs[varId].type,
+                        settings[i].logType&0x0F, 1);
 
       LOG_DEBUG("Appended variable %d to block %d\n", settings[i].id, id);
     } else {                     //Memory variable
       //TODO: Check that the address is in ram
-      ops->variable    = (void*)(&settings[i]+1);
-      ops->storageType = (settings[i].logType>>4)&0x0F;
-      ops->logType     = settings[i].logType&0x0F;
+      void * variable = (void*)(&settings[i]+1);
+      ret = blockAppend(block, variable, (settings[i].logType>>4)&0x0F,
+                        settings[i].logType&0x0F, 1);
       i += 2;
 
-      LOG_DEBUG("Appended var addr 0x%x to block %d\n", (int)ops->variable, id);
+      LOG_DEBUG("Appended var addr 0x%x to block %d\n", (int)variable, id);
     }
-    blockAppendOps(block, ops);
+
+    if (ret)
+      return ret;
 
     LOG_DEBUG("   Now lenght %d\n", blockCalcLength(block));
   }
@@ -556,21 +842,8 @@ static int logAppendBlockV2(int id, struct ops_setting_v2 * settings, int len)
 
   for (i=0; i<len; i++)
   {
-    int currentLength = blockCalcLength(block);
-    struct log_ops * ops;
     int varId;
-
-    if ((currentLength + typeLength[settings[i].logType&0x0F])>LOG_MAX_LEN) {
-      LOG_ERROR("Trying to append a full block. Block id %d.\n", id);
-      return E2BIG;
-    }
-
-    ops = opsMalloc();
-
-    if(!ops) {
-      LOG_ERROR("No more ops memory free!\n");
-      return ENOMEM;
-    }
+    int ret;
 
     if (settings[i].id != 0xFFFFul)  //TOC variable
     {
@@ -581,21 +854,23 @@ static int logAppendBlockV2(int id, struct ops_setting_v2 * settings, int len)
         return ENOENT;
       }
 
-      ops->variable    = logs[varId].address;
-      ops->storageType = logs[varId].type;
-      ops->logType     = settings[i].logType&0x0F;
+      // The first element of arrays, as listed in the item replies
+      ret = blockAppend(block, logs[varId].address, logs[varId].type,
+                        settings[i].logType&0x0F, 1);
 
       LOG_DEBUG("Appended variable %d to block %d\n", settings[i].id, id);
     } else {                     //Memory variable
       //TODO: Check that the address is in ram
-      ops->variable    = (void*)(&settings[i]+1);
-      ops->storageType = (settings[i].logType>>4)&0x0F;
-      ops->logType     = settings[i].logType&0x0F;
+      void * variable = (void*)(&settings[i]+1);
+      ret = blockAppend(block, variable, (settings[i].logType>>4)&0x0F,
+                        settings[i].logType&0x0F, 1);
       i += 2;
 
-      LOG_DEBUG("Appended var addr 0x%x to block %d\n", (int)ops->variable, id);
+      LOG_DEBUG("Appended var addr 0x%x to block %d\n", (int)variable, id);
     }
-    blockAppendOps(block, ops);
+
+    if (ret)
+      return ret;
 
     LOG_DEBUG("   Now lenght %d\n", blockCalcLength(block));
   }
@@ -603,269 +878,1057 @@ static int logAppendBlockV2(int id, struct ops_setting_v2 * settings, int len)
   return 0;
 }
 
-static int logDeleteBlock(int id)
+static int logAppendBlockSlice(int id, struct ops_setting_slice * settings, int len)
 {
   int i;
-  struct log_ops * ops;
-  struct log_ops * opsNext;
+  struct log_block * block;
+
+  LOG_DEBUG("Appending %d slices to block %d\n", len, id);
 
   for (i=0; i<LOG_MAX_BLOCKS; i++)
     if (logBlocks[i].id == id) break;
 
   if (i >= LOG_MAX_BLOCKS) {
-    LOG_ERROR("trying to delete block id %d that doesn't exist.", id);
+    LOG_ERROR("Trying to append block id %d that doesn't exist.", id);
     return ENOENT;
   }
 
-  ops = logBlocks[i].ops;
-  while (ops)
+  block = &logBlocks[i];
+
+  for (i=0; i<len; i++)
   {
-    opsNext = ops->next;
-    opsFree(ops);
-    ops = opsNext;
-  }
+    int varId = variableGetIndex(settings[i].id);
+    int ret;
+
+    if (varId<0) {
+      LOG_ERROR("Trying to add variable Id %d that does not exists.", settings[i].id);
+      return ENOENT;
+    }
 
-  if (logBlocks[i].timer != 0) {
-    xTimerStop(logBlocks[i].timer, portMAX_DELAY);
-    xTimerDelete(logBlocks[i].timer, portMAX_DELAY);
-    logBlocks[i].timer = 0;
+    // Single variables are arrays of one element
+    int count = logs[varId].count ? logs[varId].count : 1;
+    if (settings[i].count == 0 || settings[i].first + settings[i].count > count) {
+      return EINVAL;
+    }
+
+    uint8_t storageType = logs[varId].type;
+    ret = blockAppend(block, (uint8_t*)logs[varId].address + settings[i].first * typeLength[storageType],
+                      storageType, settings[i].logType&0x0F, settings[i].count);
+    if (ret)
+      return ret;
+
+    LOG_DEBUG("Appended variable %d[%d:%d] to block %d\n", settings[i].id,
+              settings[i].first, settings[i].first + settings[i].count, id);
   }
 
-  logBlocks[i].id = BLOCK_ID_FREE;
   return 0;
 }
 
-static int logStartBlock(int id, unsigned int period)
+static void logSchedulerInsert(struct log_block * blk, TickType_t due)
 {
-  int i;
+  struct log_block ** slot = &logWheel[due & LOG_WHEEL_MASK];
 
-  for (i=0; i<LOG_MAX_BLOCKS; i++)
-    if (logBlocks[i].id == id) break;
+  blk->due = due;
+  blk->isStarted = true;
+  blk->wheelNext = *slot;
+  *slot = blk;
+}
 
-  if (i >= LOG_MAX_BLOCKS) {
-    LOG_ERROR("Trying to start block id %d that doesn't exist.", id);
-    return ENOENT;
-  }
+static void logSchedulerRemove(struct log_block * blk)
+{
+  if (!blk->isStarted)
+    return;
 
-  LOG_DEBUG("Starting block %d with period %dms\n", id, period);
+  struct log_block ** link = &logWheel[blk->due & LOG_WHEEL_MASK];
+  while (*link && *link != blk)
+    link = &(*link)->wheelNext;
 
-  if (period>0)
-  {
-    xTimerChangePeriod(logBlocks[i].timer, M2T(period), 100);
-    xTimerStart(logBlocks[i].timer, 100);
-  } else {
-    // single-shoot run
-    workerSchedule(logRunBlock, &logBlocks[i]);
-  }
+  if (*link)
+    *link = blk->wheelNext;
 
-  return 0;
+  blk->isStarted = false;
 }
 
-static int logStopBlock(int id)
+/* Select the first run of a block so that blocks with the same period do not
+ * all run in the same tick. The least used slot within one period is used. */
+static TickType_t logSchedulerPhase(TickType_t now, TickType_t period)
 {
-  int i;
+  TickType_t span = period < LOG_WHEEL_SLOTS ? period : LOG_WHEEL_SLOTS;
+  TickType_t best = 1;
+  int bestCount = LOG_MAX_BLOCKS + 1;
 
-  for (i=0; i<LOG_MAX_BLOCKS; i++)
-    if (logBlocks[i].id == id) break;
+  for (TickType_t offset = 1; offset <= span; offset++)
+  {
+    int count = 0;
+    for (struct log_block * blk = logWheel[(now + offset) & LOG_WHEEL_MASK]; blk; blk = blk->wheelNext)
+      count++;
 
-  if (i >= LOG_MAX_BLOCKS) {
-    LOG_ERROR("Trying to stop block id %d that doesn't exist.\n", id);
-    return ENOENT;
+    if (count < bestCount)
+    {
+      best = offset;
+      bestCount = count;
+    }
   }
 
-  xTimerStop(logBlocks[i].timer, portMAX_DELAY);
-
-  return 0;
+  return now + best;
 }
 
-/* This function is called by the timer subsystem */
-void logBlockTimed(xTimerHandle timer)
+/* Poll the condition of a triggered block. Returns true if the block should
+ * be sent now, always true for blocks that are not triggered. */
+static bool logTriggerTest(struct log_block * blk, TickType_t now)
 {
-  workerSchedule(logRunBlock, pvTimerGetTimerID(timer));
-}
+  struct log_trigger * trig = &blk->trigger;
+  float value;
 
-/* Appends data to a packet if space is available; returns false on failure. */
-static bool appendToPacket(CRTPPacket * pk, const void * data, size_t n) {
-  if (pk->size <= CRTP_MAX_DATA_SIZE - n)
+  switch (trig->mode)
   {
-    memcpy(&pk->data[pk->size], data, n);
-    pk->size += n;
-    return true;
+    case LOG_TRIGGER_NONE:
+      return true;
+    case LOG_TRIGGER_CHANGE:
+      value = logGetFloat(trig->varIndex);
+      if (fabsf(value - trig->lastValue) >= trig->trigger.threshold)
+        trig->pending = true;
+      break;
+    default:
+    {
+      // Only the release of the trigger is sent, not every poll after it
+      bool wasReleased = trig->trigger.released;
+      if (triggerTestValue(&trig->trigger, logGetFloat(trig->varIndex)) && !wasReleased)
+        trig->pending = true;
+      break;
+    }
   }
-  else return false;
+
+  return trig->pending && (now - trig->lastSent) >= trig->minInterval;
 }
 
-/* This function is usually called by the worker subsystem */
-void logRunBlock(void * arg)
+static void logTriggerSent(struct log_block * blk, TickType_t now)
 {
-  struct log_block *blk = arg;
-  struct log_ops *ops = blk->ops;
-  static CRTPPacket pk;
-  unsigned int timestamp;
+  struct log_trigger * trig = &blk->trigger;
 
-  xSemaphoreTake(logLock, portMAX_DELAY);
+  if (trig->mode == LOG_TRIGGER_CHANGE)
+    trig->lastValue = logGetFloat(trig->varIndex);
 
-  timestamp = ((long long)xTaskGetTickCount())/portTICK_RATE_MS;
+  trig->pending = false;
+  trig->lastSent = now;
+}
 
-  pk.header = CRTP_HEADER(CRTP_PORT_LOG, LOG_CH);
-  pk.size = 4;
-  pk.data[0] = blk->id;
-  pk.data[1] = timestamp&0x0ff;
-  pk.data[2] = (timestamp>>8)&0x0ff;
-  pk.data[3] = (timestamp>>16)&0x0ff;
+/* Run the blocks that are due. Returns false if the link is down. */
+static bool logSchedulerRun(TickType_t now)
+{
+  // All slots are visited at most once, blocks further ahead stay in their slot
+  TickType_t steps = now - logWheelTick;
+  if (steps > LOG_WHEEL_SLOTS)
+    steps = LOG_WHEEL_SLOTS;
 
-  while (ops)
+  for (TickType_t step = 1; step <= steps; step++)
   {
-    int valuei = 0;
-    float valuef = 0;
+    struct log_block ** slot = &logWheel[(logWheelTick + step) & LOG_WHEEL_MASK];
+    struct log_block * blk = *slot;
+    *slot = NULL;
 
-    // FPU instructions must run on aligned data.
-    // We first copy the data to an (aligned) local variable, before assigning it
-    switch(ops->storageType)
+    while (blk)
     {
-      case LOG_UINT8:
-      {
-        uint8_t v;
-        memcpy(&v, ops->variable, sizeof(v));
-        valuei = v;
-        break;
-      }
-      case LOG_INT8:
-      {
-        int8_t v;
-        memcpy(&v, ops->variable, sizeof(v));
-        valuei = v;
-        break;
-      }
-      case LOG_UINT16:
-      {
-        uint16_t v;
-        memcpy(&v, ops->variable, sizeof(v));
-        valuei = v;
-        break;
-      }
-      case LOG_INT16:
-      {
-        int16_t v;
-        memcpy(&v, ops->variable, sizeof(v));
-        valuei = v;
-        break;
-      }
-      case LOG_UINT32:
-      {
-        uint32_t v;
-        memcpy(&v, ops->variable, sizeof(v));
-        valuei = v;
-        break;
-      }
-      case LOG_INT32:
-      {
-        int32_t v;
-        memcpy(&v, ops->variable, sizeof(v));
-        valuei = v;
-        break;
-      }
-      case LOG_FLOAT:
-      {
-        float v;
-        memcpy(&v, ops->variable, sizeof(v));
-        valuei = v;
-        break;
-      }
-    }
+      struct log_block * next = blk->wheelNext;
+      blk->isStarted = false;
 
-    if (ops->logType == LOG_FLOAT || ops->logType == LOG_FP16)
-    {
-      if (ops->storageType == LOG_FLOAT)
+      if ((int32_t)(now - blk->due) < 0)
       {
-        memcpy(&valuef, ops->variable, sizeof(valuef));
+        // Due in a later round of the wheel
+        logSchedulerInsert(blk, blk->due);
       }
       else
       {
-        valuef = valuei;
+        if (!logTriggerTest(blk, now))
+        {
+          // Nothing to send
+        }
+        // Skip the sample rather than having it dropped by a full TX queue
+        else if (crtpGetFreeTxQueuePackets(CRTP_PORT_LOG) < LOG_MIN_FREE_TX_PACKETS)
+        {
+          if (blk->period == 0)
+          {
+            // One-shot blocks have no next sample, retry at the next tick
+            logSchedulerInsert(blk, now + 1);
+          }
+          else
+          {
+            blk->skipped++;
+            logSkippedTotal++;
+          }
+        }
+        else if (!logRunBlock(blk))
+        {
+          return false;
+        }
+        else
+        {
+          logTriggerSent(blk, now);
+        }
+
+        if (blk->period > 0)
+        {
+          TickType_t due = blk->due + blk->period;
+
+          // Samples that have been missed altogether are skipped as well
+          while ((int32_t)(now - due) >= 0)
+          {
+            due += blk->period;
+            blk->skipped++;
+            logSkippedTotal++;
+          }
+          logSchedulerInsert(blk, due);
+        }
       }
 
-      // Try to append the next item to the packet.  If we run out of space,
-      // drop this and subsequent items.
-      if (ops->logType == LOG_FLOAT)
-      {
-        if (!appendToPacket(&pk, &valuef, 4)) break;
-      }
-      else
-      {
-        valuei = single2half(valuef);
-        if (!appendToPacket(&pk, &valuei, 2)) break;
-      }
-    }
-    else  //logType is an integer
-    {
-      if (!appendToPacket(&pk, &valuei, typeLength[ops->logType])) break;
+      blk = next;
     }
-
-    ops = ops->next;
   }
 
-  xSemaphoreGive(logLock);
-
-  // Check if the connection is still up, oherwise disable
-  // all the logging and flush all the CRTP queues.
-  if (!crtpIsConnected())
-  {
-    logReset();
-    crtpReset();
-  }
-  else
-  {
-    crtpSendPacket(&pk);
-  }
+  logWheelTick = now;
+  return true;
 }
 
-static int variableGetIndex(int id)
+static TickType_t logSchedulerTimeout(TickType_t now)
 {
-  int i;
-  int n=0;
+  TickType_t timeout = portMAX_DELAY;
 
-  for (i=0; i<logsLen; i++)
+  for (int i = 0; i < LOG_MAX_BLOCKS; i++)
   {
-    if(!(logs[i].type & LOG_GROUP))
+    if (logBlocks[i].id != BLOCK_ID_FREE && logBlocks[i].isStarted)
     {
-      if(n==id)
-        break;
-      n++;
+      TickType_t untilDue = (int32_t)(logBlocks[i].due - now) > 0 ? logBlocks[i].due - now : 0;
+      if (untilDue < timeout)
+        timeout = untilDue;
     }
   }
 
-  if (i>=logsLen)
-    return -1;
-
-  return i;
+  return timeout;
 }
 
-static struct log_ops * opsMalloc()
+static void logSchedulerTask(void * prm)
 {
-  int i;
+  TickType_t timeout = portMAX_DELAY;
 
-  for (i=0;i<LOG_MAX_OPS; i++)
-      if (logOps[i].variable == NULL) break;
+  logWheelTick = xTaskGetTickCount();
 
-  if (i >= LOG_MAX_OPS)
-      return NULL;
+  while (1)
+  {
+    ulTaskNotifyTake(pdTRUE, timeout);
 
-  return &logOps[i];
-}
+    xSemaphoreTake(logLock, portMAX_DELAY);
+    TickType_t now = xTaskGetTickCount();
+    bool isConnected = logSchedulerRun(now);
 
-static void opsFree(struct log_ops * ops)
-{
-  ops->variable = NULL;
+    // Check if the connection is still up, otherwise disable
+    // all the logging and flush all the CRTP queues.
+    if (!isConnected)
+    {
+      logReset();
+      logWheelTick = now;
+    }
+
+    timeout = logSchedulerTimeout(now);
+    xSemaphoreGive(logLock);
+
+    if (!isConnected)
+    {
+      crtpReset();
+    }
+  }
 }
 
-static int blockCalcLength(struct log_block * block)
+static int logDeleteBlock(int id)
+{
+  int i;
+  struct log_ops * ops;
+  struct log_ops * opsNext;
+
+  for (i=0; i<LOG_MAX_BLOCKS; i++)
+    if (logBlocks[i].id == id) break;
+
+  if (i >= LOG_MAX_BLOCKS) {
+    LOG_ERROR("trying to delete block id %d that doesn't exist.", id);
+    return ENOENT;
+  }
+
+  ops = logBlocks[i].ops;
+  while (ops)
+  {
+    opsNext = ops->next;
+    opsFree(ops);
+    ops = opsNext;
+  }
+
+  logSchedulerRemove(&logBlocks[i]);
+
+  blockFree(&logBlocks[i]);
+  return 0;
+}
+
+static int logStartBlock(int id, unsigned int period)
+{
+  int i;
+
+  for (i=0; i<LOG_MAX_BLOCKS; i++)
+    if (logBlocks[i].id == id) break;
+
+  if (i >= LOG_MAX_BLOCKS) {
+    LOG_ERROR("Trying to start block id %d that doesn't exist.", id);
+    return ENOENT;
+  }
+
+  // Triggered blocks are polled at the period
+  struct log_trigger * trig = &logBlocks[i].trigger;
+  if (trig->mode != LOG_TRIGGER_NONE && period == 0) {
+    return EINVAL;
+  }
+
+  LOG_DEBUG("Starting block %d with period %dms\n", id, period);
+
+  // A period of 0 is a single shot run
+  TickType_t now = xTaskGetTickCount();
+  logSchedulerRemove(&logBlocks[i]);
+  logBlocks[i].period = M2T(period);
+  logBlocks[i].skipped = 0;
+  logSchedulerInsert(&logBlocks[i], logSchedulerPhase(now, logBlocks[i].period));
+
+  // The first condition that fires is sent right away, change triggered
+  // blocks are always sent at the first poll
+  trig->pending = (trig->mode == LOG_TRIGGER_CHANGE);
+  trig->lastSent = now - trig->minInterval;
+  if (trig->mode == LOG_TRIGGER_LE || trig->mode == LOG_TRIGGER_GE)
+    triggerActivate(&trig->trigger, true);
+
+  // Wake up the scheduler, it may be waiting for a later block
+  xTaskNotifyGive(logSchedulerHandle);
+
+  return 0;
+}
+
+static int logStopBlock(int id)
+{
+  int i;
+
+  for (i=0; i<LOG_MAX_BLOCKS; i++)
+    if (logBlocks[i].id == id) break;
+
+  if (i >= LOG_MAX_BLOCKS) {
+    LOG_ERROR("Trying to stop block id %d that doesn't exist.\n", id);
+    return ENOENT;
+  }
+
+  logSchedulerRemove(&logBlocks[i]);
+
+  return 0;
+}
+
+static int logGetBlockStats(int id, uint16_t * skipped)
+{
+  int i;
+
+  for (i=0; i<LOG_MAX_BLOCKS; i++)
+    if (logBlocks[i].id == id) break;
+
+  if (i >= LOG_MAX_BLOCKS) {
+    return ENOENT;
+  }
+
+  *skipped = logBlocks[i].skipped;
+
+  return 0;
+}
+
+static int logSetTrigger(int id, uint8_t mode, uint16_t varId, float threshold,
+                         uint8_t count, unsigned int minInterval)
+{
+  int i;
+  int varIndex = 0;
+
+  for (i=0; i<LOG_MAX_BLOCKS; i++)
+    if (logBlocks[i].id == id) break;
+
+  if (i >= LOG_MAX_BLOCKS) {
+    LOG_ERROR("Trying to trigger block id %d that doesn't exist.\n", id);
+    return ENOENT;
+  }
+
+  if (mode > LOG_TRIGGER_GE || (mode == LOG_TRIGGER_CHANGE && !(threshold >= 0.0f))) {
+    return EINVAL;
+  }
+
+  if (mode != LOG_TRIGGER_NONE) {
+    varIndex = variableGetIndex(varId);
+    if (varIndex < 0) {
+      return ENOENT;
+    }
+    // Conditions are on single variables
+    if (logs[varIndex].count) {
+      return EINVAL;
+    }
+  }
+
+  // The new condition is used from the next start of the block
+  struct log_trigger * trig = &logBlocks[i].trigger;
+  logSchedulerRemove(&logBlocks[i]);
+
+  trig->mode = mode;
+  trig->varIndex = varIndex;
+  trig->minInterval = M2T(minInterval);
+  trig->pending = false;
+  trig->lastValue = 0.0f;
+
+  switch (mode)
+  {
+    case LOG_TRIGGER_LE:
+      triggerInit(&trig->trigger, triggerFuncIsLE, threshold, count);
+      break;
+    case LOG_TRIGGER_GE:
+      triggerInit(&trig->trigger, triggerFuncIsGE, threshold, count);
+      break;
+    default:
+      trig->trigger.threshold = threshold;
+      break;
+  }
+
+  return 0;
+}
+
+static int logSetEncoding(int id, uint8_t keyframeInterval)
+{
+  int i;
+
+  for (i=0; i<LOG_MAX_BLOCKS; i++)
+    if (logBlocks[i].id == id) break;
+
+  if (i >= LOG_MAX_BLOCKS) {
+    LOG_ERROR("Trying to encode block id %d that doesn't exist.\n", id);
+    return ENOENT;
+  }
+
+  uint8_t oldKeyframeInterval = logBlocks[i].keyframeInterval;
+
+  // Encoded blocks need one byte for the frame header
+  logBlocks[i].keyframeInterval = keyframeInterval;
+  if (blockCalcLength(&logBlocks[i]) > blockMaxLength(&logBlocks[i])) {
+    logBlocks[i].keyframeInterval = oldKeyframeInterval;
+    return E2BIG;
+  }
+
+  logBlocks[i].framesToKeyframe = 0;
+  logBlocks[i].sequence = 0;
+
+  return 0;
+}
+
+static int logSetTimestamp(int id, uint8_t mode)
+{
+  int i;
+
+  for (i=0; i<LOG_MAX_BLOCKS; i++)
+    if (logBlocks[i].id == id) break;
+
+  if (i >= LOG_MAX_BLOCKS) {
+    LOG_ERROR("Trying to stamp block id %d that doesn't exist.\n", id);
+    return ENOENT;
+  }
+
+  if (mode > LOG_TIMESTAMP_USEC) {
+    return EINVAL;
+  }
+
+  uint8_t oldMode = logBlocks[i].timestampMode;
+
+  // Microsecond timestamps are one byte longer
+  logBlocks[i].timestampMode = mode;
+  if (blockCalcLength(&logBlocks[i]) > blockMaxLength(&logBlocks[i])) {
+    logBlocks[i].timestampMode = oldMode;
+    return E2BIG;
+  }
+
+  // Encoded blocks restart with a keyframe
+  logBlocks[i].framesToKeyframe = 0;
+
+  return 0;
+}
+
+static int logSetQuantization(int id, int index, float scale, float offset)
+{
+  int i;
+  struct log_ops * ops;
+
+  for (i=0; i<LOG_MAX_BLOCKS; i++)
+    if (logBlocks[i].id == id) break;
+
+  if (i >= LOG_MAX_BLOCKS) {
+    LOG_ERROR("Trying to quantize block id %d that doesn't exist.\n", id);
+    return ENOENT;
+  }
+
+  for (ops = logBlocks[i].ops; ops && index > 0; ops = ops->next)
+    index--;
+
+  if (!ops)
+    return ENOENT;
+
+  // Only single variables logged as 8 or 16 bit integers can be quantized
+  if (scale == 0.0f || ops->count > 1 || ops->logType == LOG_FLOAT || ops->logType == LOG_FP16 ||
+      typeLength[ops->logType] > 2)
+    return EINVAL;
+
+  if (!ops->quantization)
+  {
+    for (i=0; i<LOG_MAX_QUANTIZATIONS; i++)
+      if (logQuantizations[i].invScale == 0.0f) break;
+
+    if (i >= LOG_MAX_QUANTIZATIONS)
+      return ENOMEM;
+
+    ops->quantization = i + 1;
+  }
+
+  logQuantizations[ops->quantization - 1].invScale = 1.0f / scale;
+  logQuantizations[ops->quantization - 1].offset = offset;
+
+  return 0;
+}
+
+static int logSetAggregation(int id, int index, uint8_t mode, uint8_t divider)
+{
+  int i;
+  struct log_ops * ops;
+
+  for (i=0; i<LOG_MAX_BLOCKS; i++)
+    if (logBlocks[i].id == id) break;
+
+  if (i >= LOG_MAX_BLOCKS) {
+    LOG_ERROR("Trying to aggregate block id %d that doesn't exist.\n", id);
+    return ENOENT;
+  }
+
+  for (ops = logBlocks[i].ops; ops && index > 0; ops = ops->next)
+    index--;
+
+  if (!ops)
+    return ENOENT;
+
+  if (mode > LOG_AGGREGATION_MAX || (mode != LOG_AGGREGATION_NONE && (divider == 0 || ops->count > 1)))
+    return EINVAL;
+
+  if (mode == LOG_AGGREGATION_NONE)
+  {
+    if (ops->aggregation)
+      logAggregations[ops->aggregation - 1].mode = LOG_AGGREGATION_NONE;
+    ops->aggregation = 0;
+    return 0;
+  }
+
+  if (!ops->aggregation)
+  {
+    for (i=0; i<LOG_MAX_AGGREGATIONS; i++)
+      if (logAggregations[i].mode == LOG_AGGREGATION_NONE) break;
+
+    if (i >= LOG_MAX_AGGREGATIONS)
+      return ENOMEM;
+
+    ops->aggregation = i + 1;
+  }
+
+  int n = ops->aggregation - 1;
+  struct log_aggregation * agg = &logAggregations[n];
+
+  // The stabilizer loop must not see a half configured aggregation
+  taskENTER_CRITICAL();
+  logAggregationLoads[n].source = ops->variable;
+  logAggregationLoads[n].storageType = ops->storageType;
+  agg->divider = divider;
+  agg->ticksToSample = 1;
+  agg->count = 0;
+  agg->mode = mode;
+  taskEXIT_CRITICAL();
+
+  return 0;
+}
+
+static void logCompilePrograms(void)
+{
+  int n = 0;
+
+  for (int i = 0; i < LOG_MAX_BLOCKS; i++)
+  {
+    struct log_block * blk = &logBlocks[i];
+    struct log_program_op * prev = NULL;
+    uint8_t offset = blockHeaderSize(blk);
+
+    blk->programStart = n;
+    blk->programLength = 0;
+    blk->size = offset;
+    blk->aggregationMask = 0;
+
+    if (blk->id == BLOCK_ID_FREE)
+      continue;
+
+    for (struct log_ops * ops = blk->ops; ops; ops = ops->next)
+    for (int e = 0; e < ops->count; e++)
+    {
+      uint8_t length = typeLength[ops->logType];
+      uint8_t kind;
+      const void * source = (const uint8_t*)ops->variable + e * typeLength[ops->storageType];
+      uint8_t storageType = ops->storageType;
+
+      // Aggregated variables are sent from the float result of the aggregation
+      if (ops->aggregation)
+      {
+        source = &logAggregations[ops->aggregation - 1].result;
+        storageType = LOG_FLOAT;
+        blk->aggregationMask |= 1 << (ops->aggregation - 1);
+      }
+
+      if (ops->quantization)
+      {
+        kind = LOG_PROGRAM_QUANTIZE;
+      }
+      else if (storageType == ops->logType)
+      {
+        // Variables that follow each other in memory are copied in one run,
+        // encoded blocks need one operation per variable to compute deltas
+        if (prev && prev->kind == LOG_PROGRAM_COPY && !blk->keyframeInterval &&
+            (const uint8_t*)prev->source + prev->length == source)
+        {
+          prev->length += length;
+          offset += length;
+          continue;
+        }
+        kind = LOG_PROGRAM_COPY;
+      }
+      else if (storageType == LOG_FLOAT && ops->logType == LOG_FP16)
+      {
+        kind = LOG_PROGRAM_HALF;
+      }
+      else
+      {
+        kind = LOG_PROGRAM_CONVERT;
+      }
+
+      struct log_program_op * op = &logProgram[n++];
+      op->source = source;
+      op->kind = kind;
+      op->offset = offset;
+      if (kind == LOG_PROGRAM_QUANTIZE)
+        op->quantization = ops->quantization - 1;
+      else
+        op->length = length;
+      op->storageType = storageType;
+      op->logType = ops->logType;
+
+      prev = op;
+      offset += length;
+    }
+
+    blk->programLength = n - blk->programStart;
+    blk->size = offset;
+  }
+}
+
+static void logRunConvert(const struct log_program_op * op, uint8_t * dest);
+
+static float logRunLoadFloat(const struct log_program_op * op)
+{
+  float valuef;
+
+  if (op->storageType == LOG_FLOAT)
+  {
+    memcpy(&valuef, op->source, sizeof(valuef));
+  }
+  else
+  {
+    struct log_program_op intOp = *op;
+    int32_t valuei;
+    intOp.logType = LOG_INT32;
+    logRunConvert(&intOp, (uint8_t*)&valuei);
+    valuef = valuei;
+  }
+
+  return valuef;
+}
+
+static void logRunQuantize(const struct log_program_op * op, uint8_t * dest)
+{
+  const struct log_quantization * q = &logQuantizations[op->quantization];
+  float value = roundf((logRunLoadFloat(op) - q->offset) * q->invScale);
+
+  switch (op->logType)
+  {
+    case LOG_INT8:
+      *(int8_t*)dest = value < INT8_MIN ? INT8_MIN : (value > INT8_MAX ? INT8_MAX : value);
+      break;
+    case LOG_UINT8:
+      *dest = value < 0 ? 0 : (value > UINT8_MAX ? UINT8_MAX : value);
+      break;
+    case LOG_INT16:
+    {
+      int16_t v = value < INT16_MIN ? INT16_MIN : (value > INT16_MAX ? INT16_MAX : value);
+      memcpy(dest, &v, sizeof(v));
+      break;
+    }
+    case LOG_UINT16:
+    {
+      uint16_t v = value < 0 ? 0 : (value > UINT16_MAX ? UINT16_MAX : value);
+      memcpy(dest, &v, sizeof(v));
+      break;
+    }
+  }
+}
+
+/* Replace the values of a frame with deltas against the last frame of the
+ * block, if all deltas fit. Returns the new size of the packet data. */
+static uint8_t logEncodeFrame(struct log_block * blk, CRTPPacket * pk)
+{
+  const int headerSize = blockHeaderSize(blk);
+  const bool isUsec = (blk->timestampMode == LOG_TIMESTAMP_USEC);
+  uint8_t * frameHeader = isUsec ? &pk->data[1] : &pk->data[4];
+  uint8_t * frame = &pk->data[headerSize];
+  uint8_t frameLength = blk->size - headerSize;
+  uint8_t delta[LOG_MAX_LEN];
+  uint8_t deltaLength = 0;
+  bool isKeyframe = (blk->framesToKeyframe == 0);
+  uint32_t timestampDelta = 0;
+
+  if (isUsec)
+  {
+    uint32_t timestamp;
+    memcpy(&timestamp, &pk->data[2], sizeof(timestamp));
+    timestampDelta = timestamp - blk->lastTimestamp;
+    blk->lastTimestamp = timestamp;
+
+    if (timestampDelta > UINT16_MAX)
+      isKeyframe = true;
+  }
+
+  const struct log_program_op * op = &logProgram[blk->programStart];
+  const struct log_program_op * end = op + blk->programLength;
+  for (; op < end && !isKeyframe; op++)
+  {
+    uint8_t length = typeLength[op->logType];
+    const uint8_t * value = &pk->data[op->offset];
+
+    if (op->logType == LOG_FLOAT || op->logType == LOG_FP16)
+    {
+      memcpy(&delta[deltaLength], value, length);
+      deltaLength += length;
+    }
+    else
+    {
+      // Difference modulo the size of the type, sign extended
+      uint32_t current = 0;
+      uint32_t last = 0;
+      memcpy(&current, value, length);
+      memcpy(&last, &blk->lastFrame[op->offset - headerSize], length);
+      int shift = 32 - 8 * length;
+      int32_t diff = ((int32_t)((current - last) << shift)) >> shift;
+
+      if (diff < INT8_MIN || diff > INT8_MAX)
+        isKeyframe = true;
+
+      delta[deltaLength++] = (int8_t)diff;
+    }
+  }
+
+  memcpy(blk->lastFrame, frame, frameLength);
+  *frameHeader = blk->sequence & LOG_ENCODED_SEQUENCE_MASK;
+  blk->sequence++;
+
+  if (isKeyframe)
+  {
+    blk->framesToKeyframe = blk->keyframeInterval - 1;
+    return blk->size;
+  }
+
+  blk->framesToKeyframe--;
+  *frameHeader |= LOG_ENCODED_DELTA_FRAME;
+
+  if (isUsec)
+  {
+    // The timestamp of delta frames is 2 bytes shorter
+    uint16_t timestampDelta16 = timestampDelta;
+    memcpy(&pk->data[2], &timestampDelta16, sizeof(timestampDelta16));
+    memcpy(&pk->data[headerSize - 2], delta, deltaLength);
+    return headerSize - 2 + deltaLength;
+  }
+
+  memcpy(frame, delta, deltaLength);
+
+  return headerSize + deltaLength;
+}
+
+static void logRunConvert(const struct log_program_op * op, uint8_t * dest)
+{
+  int valuei = 0;
+  float valuef = 0;
+
+  // FPU instructions must run on aligned data.
+  // We first copy the data to an (aligned) local variable, before assigning it
+  switch(op->storageType)
+  {
+    case LOG_UINT8:
+    {
+      uint8_t v;
+      memcpy(&v, op->source, sizeof(v));
+      valuei = v;
+      break;
+    }
+    case LOG_INT8:
+    {
+      int8_t v;
+      memcpy(&v, op->source, sizeof(v));
+      valuei = v;
+      break;
+    }
+    case LOG_UINT16:
+    {
+      uint16_t v;
+      memcpy(&v, op->source, sizeof(v));
+      valuei = v;
+      break;
+    }
+    case LOG_INT16:
+    {
+      int16_t v;
+      memcpy(&v, op->source, sizeof(v));
+      valuei = v;
+      break;
+    }
+    case LOG_UINT32:
+    {
+      uint32_t v;
+      memcpy(&v, op->source, sizeof(v));
+      valuei = v;
+      break;
+    }
+    case LOG_INT32:
+    {
+      int32_t v;
+      memcpy(&v, op->source, sizeof(v));
+      valuei = v;
+      break;
+    }
+    case LOG_FLOAT:
+    {
+      float v;
+      memcpy(&v, op->source, sizeof(v));
+      valuei = v;
+      valuef = v;
+      break;
+    }
+  }
+
+  if (op->logType == LOG_FLOAT || op->logType == LOG_FP16)
+  {
+    if (op->storageType != LOG_FLOAT)
+    {
+      valuef = valuei;
+    }
+
+    if (op->logType == LOG_FLOAT)
+    {
+      memcpy(dest, &valuef, 4);
+    }
+    else
+    {
+      uint16_t valueh = single2half(valuef);
+      memcpy(dest, &valueh, 2);
+    }
+  }
+  else  //logType is an integer
+  {
+    memcpy(dest, &valuei, typeLength[op->logType]);
+  }
+}
+
+/* Sample the aggregated variables, called by the stabilizer loop at every tick.
+ * It runs at a higher priority than the log tasks, that only change the
+ * aggregations in critical sections. */
+void logAggregationUpdate(void)
+{
+  for (int i = 0; i < LOG_MAX_AGGREGATIONS; i++)
+  {
+    struct log_aggregation * agg = &logAggregations[i];
+
+    if (agg->mode == LOG_AGGREGATION_NONE || --agg->ticksToSample > 0)
+      continue;
+    agg->ticksToSample = agg->divider;
+
+    float value = logRunLoadFloat(&logAggregationLoads[i]);
+
+    if (agg->count == 0)
+      agg->accumulator = value;
+    else if (agg->mode == LOG_AGGREGATION_MEAN)
+      agg->accumulator += value;
+    else if (agg->mode == LOG_AGGREGATION_MIN)
+      agg->accumulator = fminf(agg->accumulator, value);
+    else
+      agg->accumulator = fmaxf(agg->accumulator, value);
+
+    if (agg->count < UINT16_MAX)
+      agg->count++;
+  }
+}
+
+/* Compute the results of the aggregations of a block and start new periods */
+static void logAggregationLatch(uint16_t mask)
+{
+  taskENTER_CRITICAL();
+  for (int i = 0; mask; i++, mask >>= 1)
+  {
+    struct log_aggregation * agg = &logAggregations[i];
+
+    if (!(mask & 1))
+      continue;
+
+    if (agg->count == 0)
+      // Not sampled in the period, send the value as it is
+      agg->result = logRunLoadFloat(&logAggregationLoads[i]);
+    else if (agg->mode == LOG_AGGREGATION_MEAN)
+      agg->result = agg->accumulator / agg->count;
+    else
+      agg->result = agg->accumulator;
+
+    agg->count = 0;
+  }
+  taskEXIT_CRITICAL();
+}
+
+/* Run a block and send the packet, called by the scheduler with the log lock
+ * taken. Returns false if the link is down. */
+static bool logRunBlock(struct log_block * blk)
+{
+  static CRTPPacket pk;
+  unsigned int timestamp;
+
+  if (!crtpIsConnected())
+  {
+    return false;
+  }
+
+  pk.header = CRTP_HEADER(CRTP_PORT_LOG, LOG_CH);
+  pk.size = blk->size;
+  pk.data[0] = blk->id;
+
+  if (blk->aggregationMask)
+  {
+    logAggregationLatch(blk->aggregationMask);
+  }
+
+  // Stamped right before the variables are sampled
+  if (blk->timestampMode == LOG_TIMESTAMP_USEC)
+  {
+    uint32_t timestampUs = usecTimestamp();
+    // After the frame header of encoded blocks
+    memcpy(&pk.data[blk->keyframeInterval ? 2 : 1], &timestampUs, sizeof(timestampUs));
+  }
+  else
+  {
+    timestamp = ((long long)xTaskGetTickCount())/portTICK_RATE_MS;
+    pk.data[1] = timestamp&0x0ff;
+    pk.data[2] = (timestamp>>8)&0x0ff;
+    pk.data[3] = (timestamp>>16)&0x0ff;
+  }
+
+  const struct log_program_op * op = &logProgram[blk->programStart];
+  const struct log_program_op * end = op + blk->programLength;
+  for (; op < end; op++)
+  {
+    uint8_t * dest = &pk.data[op->offset];
+
+    switch (op->kind)
+    {
+      case LOG_PROGRAM_COPY:
+        memcpy(dest, op->source, op->length);
+        break;
+      case LOG_PROGRAM_HALF:
+      {
+        float valuef;
+        memcpy(&valuef, op->source, sizeof(valuef));
+        uint16_t valueh = single2half(valuef);
+        memcpy(dest, &valueh, 2);
+        break;
+      }
+      case LOG_PROGRAM_QUANTIZE:
+        logRunQuantize(op, dest);
+        break;
+      default:
+        logRunConvert(op, dest);
+        break;
+    }
+  }
+
+  if (blk->keyframeInterval)
+  {
+    pk.size = logEncodeFrame(blk, &pk);
+  }
+
+  crtpSendPacket(&pk);
+  return true;
+}
+
+static int variableGetIndex(int id)
+{
+  return tocIndexGetEntry(&logsIndex, id);
+}
+
+static struct log_ops * opsMalloc()
+{
+  struct log_ops * ops = opsFreeList;
+
+  if (!ops)
+    return NULL;
+
+  opsFreeList = ops->next;
+  ops->next = NULL;
+  if (++opsUsed > opsHighWater)
+    opsHighWater = opsUsed;
+
+  return ops;
+}
+
+static void opsFree(struct log_ops * ops)
+{
+  if (ops->quantization)
+    logQuantizations[ops->quantization - 1].invScale = 0.0f;
+
+  if (ops->aggregation)
+    logAggregations[ops->aggregation - 1].mode = LOG_AGGREGATION_NONE;
+
+  logElements -= ops->count;
+
+  ops->quantization = 0;
+  ops->aggregation = 0;
+  ops->count = 0;
+  ops->variable = NULL;
+  ops->next = opsFreeList;
+  opsFreeList = ops;
+  opsUsed--;
+}
+
+static int blockHeaderSize(struct log_block * block)
+{
+  // Block id and timestamp, encoded blocks need one byte for the frame header
+  return 1 + (block->timestampMode == LOG_TIMESTAMP_USEC ? 4 : 3) +
+         (block->keyframeInterval ? 1 : 0);
+}
+
+static int blockMaxLength(struct log_block * block)
+{
+  return LOG_MAX_LEN + 4 - blockHeaderSize(block);
+}
+
+static int blockCalcLength(struct log_block * block)
 {
   struct log_ops * ops;
   int len = 0;
 
   for (ops = block->ops; ops; ops = ops->next)
-    len += typeLength[ops->logType];
+    len += typeLength[ops->logType] * ops->count;
 
   return len;
 }
@@ -902,30 +1965,51 @@ static void logReset(void)
   }
 
   //Force free all the log block objects
-  for(i=0; i<LOG_MAX_BLOCKS; i++)
+  blocksFreeList = NULL;
+  for(i=LOG_MAX_BLOCKS-1; i>=0; i--)
+  {
     logBlocks[i].id = BLOCK_ID_FREE;
+    logBlocks[i].isStarted = false;
+    logBlocks[i].nextFree = blocksFreeList;
+    blocksFreeList = &logBlocks[i];
+  }
+  blocksUsed = 0;
+
+  for(i=0; i<LOG_WHEEL_SLOTS; i++)
+    logWheel[i] = NULL;
 
   //Force free the log ops
-  for (i=0; i<LOG_MAX_OPS; i++)
+  opsFreeList = NULL;
+  for (i=LOG_MAX_OPS-1; i>=0; i--)
+  {
     logOps[i].variable = NULL;
+    logOps[i].quantization = 0;
+    logOps[i].aggregation = 0;
+    logOps[i].count = 0;
+    logOps[i].next = opsFreeList;
+    opsFreeList = &logOps[i];
+  }
+  opsUsed = 0;
+  logElements = 0;
+
+  for (i=0; i<LOG_MAX_QUANTIZATIONS; i++)
+    logQuantizations[i].invScale = 0.0f;
+
+  for (i=0; i<LOG_MAX_AGGREGATIONS; i++)
+    logAggregations[i].mode = LOG_AGGREGATION_NONE;
+
+  logCompilePrograms();
 }
 
 /* Public API to access log TOC from within the copter */
 int logGetVarId(char* group, char* name)
 {
-  int i;
-  char * currgroup = "";
-
-  for(i=0; i<logsLen; i++)
-  {
-    if (logs[i].type & LOG_GROUP) {
-      if (logs[i].type & LOG_START)
-        currgroup = logs[i].name;
-    } if ((!strcmp(group, currgroup)) && (!strcmp(name, logs[i].name)))
-      return i;
-  }
+  return variableGetIndex(tocIndexFindId(&logsIndex, group, name));
+}
 
-  return -1;
+int logGetVarIdFromToc(int tocId)
+{
+  return variableGetIndex(tocId);
 }
 
 int logGetType(int varid)
@@ -935,23 +2019,22 @@ int logGetType(int varid)
 
 void logGetGroupAndName(int varid, char** group, char** name)
 {
-  char * currgroup = "";
   *group = 0;
   *name = 0;
 
-  for(int i=0; i<logsLen; i++) {
-    if (logs[i].type & LOG_GROUP) {
-      if (logs[i].type & LOG_START) {
-        currgroup = logs[i].name;
-      }
-    }
+  if (varid < 0 || varid >= logsLen) {
+    return;
+  }
 
-    if (i == varid) {
-      *group = currgroup;
-      *name = logs[i].name;
+  // The group start is the closest one before the variable
+  *group = "";
+  for (int i = varid; i >= 0; i--) {
+    if ((logs[i].type & LOG_GROUP) && (logs[i].type & LOG_START)) {
+      *group = logs[i].name;
       break;
     }
   }
+  *name = logs[varid].name;
 }
 
 void* logGetAddress(int varid)
@@ -1012,3 +2095,21 @@ unsigned int logGetUint(int varid)
 {
   return (unsigned int)logGetInt(varid);
 }
+
+uint32_t logTocImageSize(void)
+{
+  return tocIndexImageSize(&logsIndex);
+}
+
+bool logTocImageRead(uint32_t offset, uint8_t length, uint8_t* dest)
+{
+  return tocIndexImageRead(&logsIndex, logsCrc, offset, length, dest);
+}
+
+LOG_GROUP_START(log)
+LOG_ADD(LOG_UINT32, skipped, &logSkippedTotal)
+LOG_ADD(LOG_UINT16, opsUsed, &opsUsed)
+LOG_ADD(LOG_UINT16, opsMax, &opsHighWater)
+LOG_ADD(LOG_UINT8, blocksUsed, &blocksUsed)
+LOG_ADD(LOG_UINT8, blocksMax, &blocksHighWater)
+LOG_GROUP_STOP(log)
@@ -52,6 +52,7 @@
 
 #include "log.h"
 #include "param.h"
+#include "flight_recorder.h"
 
 #if 0
 #define MEM_DEBUG(fmt, ...) DEBUG_PRINT("D/log " fmt, ## __VA_ARGS__)
@@ -74,7 +75,10 @@
 #define LOCO2_ID        0x04
 #define LH_ID           0x05
 #define TESTER_ID       0x06
-#define OW_FIRST_ID     0x07
+#define LOG_TOC_ID      0x07
+#define PARAM_TOC_ID    0x08
+#define RECORDER_ID     0x09
+#define OW_FIRST_ID     0x0A
 
 #define STATUS_OK 0
 
@@ -86,6 +90,8 @@
 #define MEM_TYPE_LOCO2  0x13
 #define MEM_TYPE_LH     0x14
 #define MEM_TYPE_TESTER 0x15
+#define MEM_TYPE_TOC    0x16
+#define MEM_TYPE_RECORDER 0x17
 
 #define MEM_LOCO_INFO             0x0000
 #define MEM_LOCO_ANCHOR_BASE      0x1000
@@ -127,6 +133,9 @@ static const OwSerialNum eepromSerialNum =
   .data = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, EEPROM_I2C_ADDR}
 };
 static const uint8_t noData[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+// The CRTP port of the toc is sent in the info of the toc memories
+static const uint8_t logTocData[8] = {CRTP_PORT_LOG, 0, 0, 0, 0, 0, 0, 0};
+static const uint8_t paramTocData[8] = {CRTP_PORT_PARAM, 0, 0, 0, 0, 0, 0, 0};
 static CRTPPacket p;
 
 void memInit(void)
@@ -232,6 +241,15 @@ void createInfoResponse(CRTPPacket* p, uint8_t memId)
     case TESTER_ID:
       createInfoResponseBody(p, MEM_TYPE_TESTER, MEM_TESTER_SIZE, noData);
       break;
+    case LOG_TOC_ID:
+      createInfoResponseBody(p, MEM_TYPE_TOC, logTocImageSize(), logTocData);
+      break;
+    case PARAM_TOC_ID:
+      createInfoResponseBody(p, MEM_TYPE_TOC, paramTocImageSize(), paramTocData);
+      break;
+    case RECORDER_ID:
+      createInfoResponseBody(p, MEM_TYPE_RECORDER, flightRecorderMemSize(), noData);
+      break;
     default:
       if (owGetinfo(memId - OW_FIRST_ID, &serialNbr))
       {
@@ -324,6 +342,18 @@ void memReadProcess()
       status = handleMemTesterRead(memAddr, readLen, &p.data[6]);
       break;
 
+    case LOG_TOC_ID:
+      status = logTocImageRead(memAddr, readLen, &p.data[6]) ? STATUS_OK : EIO;
+      break;
+
+    case PARAM_TOC_ID:
+      status = paramTocImageRead(memAddr, readLen, &p.data[6]) ? STATUS_OK : EIO;
+      break;
+
+    case RECORDER_ID:
+      status = flightRecorderMemRead(memAddr, readLen, &p.data[6]) ? STATUS_OK : EIO;
+      break;
+
     default:
       {
         memId = memId - OW_FIRST_ID;
@@ -543,9 +573,17 @@ void memWriteProcess()
       status = handleMemTesterWrite(memAddr, writeLen, &p.data[5]);
       break;
 
+    case RECORDER_ID:
+      status = flightRecorderMemWrite(memAddr, writeLen, &p.data[5]) ? STATUS_OK : EIO;
+      break;
+
     case LOCO_ID:
         // Fall through
     case LOCO2_ID:
+        // Fall through
+    case LOG_TOC_ID:
+        // Fall through
+    case PARAM_TOC_ID:
       // Not supported
       status = EIO;
       break;
@@ -0,0 +1,352 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie Firmware
+ *
+ * Copyright (C) 2019 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * occupancy_grid.c: Horizontal occupancy grid around the Crazyflie, built
+ *                   from the range sensors
+ *
+ * Every cell holds a 2 bit saturating counter, incremented by hits and
+ * decremented when a ray passes through it. A cell is occupied when the
+ * high bit of the counter is set. The cells are packed 16 to a word, which
+ * makes it possible to skip empty parts of the grid a word at a time.
+ *
+ * The grid is a window in a world that is addressed with wrap around, world
+ * cell (x, y) is stored at (x mod size, y mod size). When the Crazyflie has
+ * moved too far from the center the window is moved and only the rows and
+ * columns that are reused are cleared, no data is copied.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "log.h"
+
+#include "occupancy_grid.h"
+#include "range.h"
+
+#define M_PI_F ((float) M_PI)
+#define DEG_TO_RAD_F (M_PI_F / 180.0f)
+
+#define CELL_BITS 2
+#define CELLS_PER_WORD (32 / CELL_BITS)
+#define WORDS_PER_ROW (OCCUPANCY_GRID_SIZE / CELLS_PER_WORD)
+#define CELL_MASK 0x3u
+#define CELL_MAX 3
+#define CELL_OCCUPIED_BIT 0x2u
+#define CELL_HIT_INCREMENT 2
+// High bit of every cell in a word
+#define WORD_OCCUPIED_MASK 0xAAAAAAAAu
+#define INDEX_MASK (OCCUPANCY_GRID_SIZE - 1)
+
+// Longer ranges are inserted as free space up to this distance (m)
+#define MAX_RAY_LENGTH 3.0f
+// The horizontal sensors see the floor or the ceiling when tilted too much (rad)
+#define MAX_TILT (20.0f * DEG_TO_RAD_F)
+// Hits closer to the floor than this are assumed to be the floor (m)
+#define FLOOR_MARGIN 0.1f
+
+static uint32_t grid[OCCUPANCY_GRID_SIZE][WORDS_PER_ROW];
+
+// World cell coordinates of the lower left corner of the grid
+static int32_t originX;
+static int32_t originY;
+static bool isPlaced = false;
+
+// Direction of the horizontal range sensors in the body frame
+static const float rayAngles[] = {
+  [rangeFront] = 0.0f,
+  [rangeBack] = M_PI_F,
+  [rangeLeft] = M_PI_F / 2.0f,
+  [rangeRight] = -M_PI_F / 2.0f,
+};
+#define NBR_OF_RAYS (sizeof(rayAngles) / sizeof(rayAngles[0]))
+
+static uint32_t lastUpdateCounts[NBR_OF_RAYS];
+
+static bool hasNearestObstacle = false;
+static point_t nearestObstacle;
+static float nearestDistance = -1.0f;
+
+static inline int32_t toCell(float position)
+{
+  return (int32_t)floorf(position / OCCUPANCY_GRID_RESOLUTION);
+}
+
+static inline float toPosition(int32_t cell)
+{
+  return (cell + 0.5f) * OCCUPANCY_GRID_RESOLUTION;
+}
+
+static inline bool isInGrid(int32_t x, int32_t y)
+{
+  return (uint32_t)(x - originX) < OCCUPANCY_GRID_SIZE && (uint32_t)(y - originY) < OCCUPANCY_GRID_SIZE;
+}
+
+static inline uint32_t cellGet(int32_t x, int32_t y)
+{
+  uint32_t ix = x & INDEX_MASK;
+  uint32_t shift = (ix % CELLS_PER_WORD) * CELL_BITS;
+  return (grid[y & INDEX_MASK][ix / CELLS_PER_WORD] >> shift) & CELL_MASK;
+}
+
+static inline void cellSet(int32_t x, int32_t y, uint32_t value)
+{
+  uint32_t ix = x & INDEX_MASK;
+  uint32_t shift = (ix % CELLS_PER_WORD) * CELL_BITS;
+  uint32_t* word = &grid[y & INDEX_MASK][ix / CELLS_PER_WORD];
+  *word = (*word & ~(CELL_MASK << shift)) | (value << shift);
+}
+
+static void markHit(int32_t x, int32_t y)
+{
+  uint32_t value = cellGet(x, y) + CELL_HIT_INCREMENT;
+  cellSet(x, y, value > CELL_MAX ? CELL_MAX : value);
+}
+
+static void markFree(int32_t x, int32_t y)
+{
+  uint32_t value = cellGet(x, y);
+  if (value > 0) {
+    cellSet(x, y, value - 1);
+  }
+}
+
+static void clearColumn(int32_t x)
+{
+  for (int32_t y = 0; y < OCCUPANCY_GRID_SIZE; y++) {
+    cellSet(x, y, 0);
+  }
+}
+
+static void clearRow(int32_t y)
+{
+  memset(grid[y & INDEX_MASK], 0, sizeof(grid[0]));
+}
+
+// Clear the rows or columns entering the grid when the origin moves by delta
+static void clearEntering(int32_t oldOrigin, int32_t newOrigin, void (*clear)(int32_t))
+{
+  int32_t delta = newOrigin - oldOrigin;
+
+  if (abs(delta) >= OCCUPANCY_GRID_SIZE) {
+    memset(grid, 0, sizeof(grid));
+  } else if (delta > 0) {
+    for (int32_t i = oldOrigin + OCCUPANCY_GRID_SIZE; i < newOrigin + OCCUPANCY_GRID_SIZE; i++) {
+      clear(i);
+    }
+  } else {
+    for (int32_t i = newOrigin; i < oldOrigin; i++) {
+      clear(i);
+    }
+  }
+}
+
+static void moveGrid(int32_t x, int32_t y)
+{
+  const int32_t halfSize = OCCUPANCY_GRID_SIZE / 2;
+
+  if (!isPlaced) {
+    memset(grid, 0, sizeof(grid));
+    originX = x - halfSize;
+    originY = y - halfSize;
+    isPlaced = true;
+    return;
+  }
+
+  // Keep the Crazyflie in the middle half of the grid
+  if (abs(x - (originX + halfSize)) > halfSize / 2) {
+    clearEntering(originX, x - halfSize, clearColumn);
+    originX = x - halfSize;
+  }
+
+  if (abs(y - (originY + halfSize)) > halfSize / 2) {
+    clearEntering(originY, y - halfSize, clearRow);
+    originY = y - halfSize;
+  }
+}
+
+// Bresenham line from (x0, y0) to (x1, y1), stops when leaving the grid
+static void raycast(int32_t x0, int32_t y0, int32_t x1, int32_t y1, bool isHit)
+{
+  int32_t dx = abs(x1 - x0);
+  int32_t dy = -abs(y1 - y0);
+  int32_t sx = x0 < x1 ? 1 : -1;
+  int32_t sy = y0 < y1 ? 1 : -1;
+  int32_t err = dx + dy;
+
+  while (isInGrid(x0, y0)) {
+    if (x0 == x1 && y0 == y1) {
+      if (isHit) {
+        markHit(x0, y0);
+      } else {
+        markFree(x0, y0);
+      }
+      break;
+    }
+
+    markFree(x0, y0);
+
+    int32_t e2 = 2 * err;
+    if (e2 >= dy) {
+      err += dy;
+      x0 += sx;
+    }
+    if (e2 <= dx) {
+      err += dx;
+      y0 += sy;
+    }
+  }
+}
+
+static void updateNearestObstacle(float x, float y)
+{
+  const int32_t radius = OCCUPANCY_GRID_SEARCH_RADIUS;
+  int32_t cx = toCell(x);
+  int32_t cy = toCell(y);
+  int32_t bestDistance2 = radius * radius + 1;
+  int32_t bestX = 0;
+  int32_t bestY = 0;
+
+  for (int32_t py = cy - radius; py <= cy + radius; py++) {
+    int32_t dy = py - cy;
+    if (dy * dy >= bestDistance2 || (uint32_t)(py - originY) >= OCCUPANCY_GRID_SIZE) {
+      continue;
+    }
+
+    const uint32_t* row = grid[py & INDEX_MASK];
+    int32_t px = cx - radius;
+    while (px <= cx + radius) {
+      uint32_t ix = px & INDEX_MASK;
+      if ((uint32_t)(px - originX) >= OCCUPANCY_GRID_SIZE) {
+        px++;
+        continue;
+      }
+
+      // Skip the rest of the word if it has no occupied cells
+      if ((row[ix / CELLS_PER_WORD] & WORD_OCCUPIED_MASK) == 0) {
+        px += CELLS_PER_WORD - (ix % CELLS_PER_WORD);
+        continue;
+      }
+
+      int32_t dx = px - cx;
+      if ((cellGet(px, py) & CELL_OCCUPIED_BIT) && dx * dx + dy * dy < bestDistance2) {
+        bestDistance2 = dx * dx + dy * dy;
+        bestX = px;
+        bestY = py;
+      }
+      px++;
+    }
+  }
+
+  hasNearestObstacle = bestDistance2 <= radius * radius;
+  if (hasNearestObstacle) {
+    nearestObstacle.x = toPosition(bestX);
+    nearestObstacle.y = toPosition(bestY);
+    float dx = nearestObstacle.x - x;
+    float dy = nearestObstacle.y - y;
+    nearestDistance = sqrtf(dx * dx + dy * dy);
+  } else {
+    nearestDistance = -1.0f;
+  }
+}
+
+void occupancyGridReset()
+{
+  isPlaced = false;
+  hasNearestObstacle = false;
+  nearestDistance = -1.0f;
+  for (uint32_t i = 0; i < NBR_OF_RAYS; i++) {
+    lastUpdateCounts[i] = rangeGetUpdateCount(i);
+  }
+}
+
+void occupancyGridInsertRay(float x, float y, float angle, float range, bool isHit)
+{
+  if (range > MAX_RAY_LENGTH) {
+    range = MAX_RAY_LENGTH;
+    isHit = false;
+  }
+
+  moveGrid(toCell(x), toCell(y));
+  raycast(toCell(x), toCell(y), toCell(x + range * cosf(angle)), toCell(y + range * sinf(angle)), isHit);
+}
+
+void occupancyGridUpdate(const state_t *state)
+{
+  const float x = state->position.x;
+  const float y = state->position.y;
+  const float yaw = state->attitude.yaw * DEG_TO_RAD_F;
+  const float tilt = fmaxf(fabsf(state->attitude.roll), fabsf(state->attitude.pitch)) * DEG_TO_RAD_F;
+
+  // Height above the floor, from the z-ranger if there is one
+  float height = state->position.z;
+  if (rangeGetUpdateCount(rangeDown) > 0) {
+    height = rangeGet(rangeDown);
+  }
+
+  moveGrid(toCell(x), toCell(y));
+
+  for (uint32_t i = 0; i < NBR_OF_RAYS; i++) {
+    uint32_t updateCount = rangeGetUpdateCount(i);
+    if (updateCount == lastUpdateCounts[i]) {
+      continue;
+    }
+    lastUpdateCounts[i] = updateCount;
+
+    float range = rangeGet(i);
+    if (tilt > MAX_TILT || range <= 0.0f) {
+      continue;
+    }
+
+    // A tilted sensor may see the floor, only rays ending above it are hits
+    bool isHit = range * sinf(tilt) < height - FLOOR_MARGIN;
+    occupancyGridInsertRay(x, y, yaw + rayAngles[i], range, isHit);
+  }
+
+  updateNearestObstacle(x, y);
+}
+
+bool occupancyGridIsOccupied(float x, float y)
+{
+  int32_t cx = toCell(x);
+  int32_t cy = toCell(y);
+
+  return isPlaced && isInGrid(cx, cy) && (cellGet(cx, cy) & CELL_OCCUPIED_BIT);
+}
+
+bool occupancyGridGetNearestObstacle(point_t *obstacle, float *distance)
+{
+  if (hasNearestObstacle) {
+    *obstacle = nearestObstacle;
+    *distance = nearestDistance;
+  }
+
+  return hasNearestObstacle;
+}
+
+LOG_GROUP_START(occGrid)
+LOG_ADD(LOG_UINT8, hasObst, &hasNearestObstacle)
+LOG_ADD(LOG_FLOAT, nearDist, &nearestDistance)
+LOG_ADD(LOG_FLOAT, nearX, &nearestObstacle.x)
+LOG_ADD(LOG_FLOAT, nearY, &nearestObstacle.y)
+LOG_GROUP_STOP(occGrid)
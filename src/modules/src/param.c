@@ -29,13 +29,17 @@
 /* FreeRtos includes */
 #include "FreeRTOS.h"
 #include "task.h"
+#include "semphr.h"
 
 #include "config.h"
 #include "crtp.h"
 #include "param.h"
+#include "flight_recorder.h"
 #include "crc.h"
 #include "console.h"
 #include "debug.h"
+#include "toc_index.h"
+#include "param_store.h"
 
 #if 0
 #define PARAM_DEBUG(fmt, ...) DEBUG_PRINT("D/param " fmt, ## __VA_ARGS__)
@@ -61,6 +65,19 @@
 #define CMD_GET_INFO_V2 3 // version 2: up to 16k entries
 
 #define MISC_SETBYNAME 0
+#define MISC_READ_BATCH 1
+#define MISC_WRITE_BATCH 2
+#define MISC_TRANSACTION_BEGIN 3
+#define MISC_TRANSACTION_COMMIT 4
+#define MISC_TRANSACTION_ABORT 5
+#define MISC_PERSISTENT_STORE 6
+#define MISC_PERSISTENT_CLEAR 7
+
+#define PARAM_TRANSACTION_MAX 32
+// An open transaction is aborted if it is not written to for this long
+#define PARAM_TRANSACTION_TIMEOUT_MS 10000
+#define PARAM_COMMIT_TIMEOUT_MS 100
+#define PARAM_MAX_CALLBACKS 16
 
 //Private functions
 static void paramTask(void * prm);
@@ -76,12 +93,22 @@ static void paramWriteProcess();
 static void paramReadProcess();
 static int variableGetIndex(int id);
 static char paramWriteByNameProcess(char* group, char* name, int type, void *valptr);
+static void paramReadBatchProcess();
+static void paramWriteBatchProcess();
+static int paramWrite(int id, const uint8_t* src);
+static void paramTransactionBegin(void);
+static int paramTransactionCommit(uint8_t* count);
+static void paramTransactionAbort(void);
+static void paramPersistentRestore(void);
+static int paramPersistentStore(int id);
+static int paramPersistentClear(int id);
 
 //Pointer to the parameters list and length of it
 static struct param_s * params;
 static int paramsLen;
 static uint32_t paramsCrc;
 static uint16_t paramsCount = 0;
+static tocIndex_t paramsIndex;
 // indicates if read/write operation use V2 (i.e., 16-bit index)
 // This is set to true, if a client uses TOC_CH in V2
 static bool useV2 = false;
@@ -90,9 +117,45 @@ static CRTPPacket p;
 
 static bool isInit = false;
 
+// Staged writes of the open transaction
+static struct {
+  uint16_t id;  // Index in params
+  uint8_t value[8];
+} staged[PARAM_TRANSACTION_MAX];
+static uint8_t stagedCount;
+static bool isTransactionOpen;
+static TickType_t transactionLastWrite;
+static volatile bool isCommitPending;
+static xSemaphoreHandle commitDone;
+// Set when a packet changed values, the flight recorder is triggered once per packet
+static bool isWriteToTrigger;
+
+static struct {
+  uint16_t id;
+  paramCallback_t callback;
+} callbacks[PARAM_MAX_CALLBACKS];
+static uint8_t callbackCount;
+
+// The type sent to the clients, persistence is internal to the copter
+static uint8_t paramGetTocType(int i)
+{
+  return params[i].type & ~PARAM_PERSISTENT;
+}
+
+static void paramGetTocEntry(int i, tocEntry_t* entry)
+{
+  if (params[i].type & PARAM_GROUP) {
+    entry->kind = (params[i].type & PARAM_START) ? tocEntryGroupStart : tocEntryGroupStop;
+  } else {
+    entry->kind = tocEntryVariable;
+  }
+  entry->type = paramGetTocType(i);
+  entry->name = params[i].name;
+  entry->count = 0;
+}
+
 void paramInit(void)
 {
-  int i;
   const char* group = NULL;
   int groupLength = 0;
 
@@ -109,7 +172,7 @@ void paramInit(void)
   {
     int len = 5;
     memcpy(&p.data[0], &paramsCrc, 4);
-    p.data[4] = params[i].type;
+    p.data[4] = paramGetTocType(i);
     if (params[i].type & PARAM_GROUP) {
       if (params[i].type & PARAM_START) {
         group = params[i].name;
@@ -130,19 +193,23 @@ void paramInit(void)
     paramsCrc = crcSlow(p.data, len);
   }
 
-  for (i=0; i<paramsLen; i++)
-  {
-    if(!(params[i].type & PARAM_GROUP))
-      paramsCount++;
-  }
+  // Index the toc once, all lookups by id and name use the index
+  paramsCount = tocIndexCountVariables(paramsLen, paramGetTocEntry);
+  uint16_t* indexStorage = pvPortMalloc(TOC_INDEX_STORAGE_SIZE(paramsCount) * sizeof(uint16_t));
+  ASSERT(indexStorage);
+  tocIndexInit(&paramsIndex, paramsLen, paramGetTocEntry, indexStorage);
+
+  vSemaphoreCreateBinary(commitDone);
+  xSemaphoreTake(commitDone, 0);
 
+  // Before the modules use the values
+  paramStoreInit();
+  paramPersistentRestore();
 
   //Start the param task
 	xTaskCreate(paramTask, PARAM_TASK_NAME,
 	            PARAM_TASK_STACKSIZE, NULL, PARAM_TASK_PRI, NULL);
 
-  //TODO: Handle stored parameters!
-
   isInit = true;
 }
 
@@ -158,6 +225,12 @@ void paramTask(void * prm)
 	while(1) {
 		crtpReceivePacketBlock(CRTP_PORT_PARAM, &p);
 
+		if (isTransactionOpen &&
+		    xTaskGetTickCount() - transactionLastWrite > M2T(PARAM_TRANSACTION_TIMEOUT_MS)) {
+		  // The client is gone
+		  paramTransactionAbort();
+		}
+
 		if (p.channel==TOC_CH)
 		  paramTOCProcess(p.data[0]);
 	  else if (p.channel==READ_CH)
@@ -191,8 +264,48 @@ void paramTask(void * prm)
         p.data[1+strlen(group)+1+strlen(name)+1] = error;
         p.size = 1+strlen(group)+1+strlen(name)+1+1;
         crtpSendPacket(&p);
+      } else if (p.data[0] == MISC_READ_BATCH) {
+        paramReadBatchProcess();
+      } else if (p.data[0] == MISC_WRITE_BATCH) {
+        paramWriteBatchProcess();
+      } else if (p.data[0] == MISC_TRANSACTION_BEGIN) {
+        paramTransactionBegin();
+        p.data[1] = 0;
+        p.size = 2;
+        crtpSendPacket(&p);
+      } else if (p.data[0] == MISC_TRANSACTION_COMMIT) {
+        uint8_t count;
+        p.data[1] = paramTransactionCommit(&count);
+        p.data[2] = count;
+        p.size = 3;
+        crtpSendPacket(&p);
+      } else if (p.data[0] == MISC_TRANSACTION_ABORT) {
+        paramTransactionAbort();
+        p.data[1] = 0;
+        p.size = 2;
+        crtpSendPacket(&p);
+      } else if (p.data[0] == MISC_PERSISTENT_STORE || p.data[0] == MISC_PERSISTENT_CLEAR) {
+        // [command][id, 2 bytes] -> [command][id, 2 bytes][error]
+        uint16_t ident;
+        memcpy(&ident, &p.data[1], 2);
+        int id = variableGetIndex(ident);
+
+        if (id < 0) {
+          p.data[3] = ENOENT;
+        } else if (p.data[0] == MISC_PERSISTENT_STORE) {
+          p.data[3] = paramPersistentStore(id);
+        } else {
+          p.data[3] = paramPersistentClear(id);
+        }
+        p.size = 4;
+        crtpSendPacket(&p);
       }
     }
+
+    if (isWriteToTrigger) {
+      flightRecorderTrigger(flightRecorderTriggerParamWrite);
+      isWriteToTrigger = false;
+    }
 	}
 }
 
@@ -221,29 +334,16 @@ void paramTOCProcess(int command)
     crtpSendPacket(&p);
     break;
   case CMD_GET_ITEM:  //Get param variable
-    for (ptr=0; ptr<paramsLen; ptr++) //Ptr points a group
-    {
-      if (params[ptr].type & PARAM_GROUP)
-      {
-        if (params[ptr].type & PARAM_START)
-          group = params[ptr].name;
-        else
-          group = "";
-      }
-      else                          //Ptr points a variable
-      {
-        if (n==p.data[1])
-          break;
-        n++;
-      }
-    }
+    n = p.data[1];
+    ptr = tocIndexGetEntry(&paramsIndex, n);
 
-    if (ptr<paramsLen)
+    if (ptr >= 0)
     {
+      group = params[tocIndexGetGroup(&paramsIndex, n)].name;
       p.header=CRTP_HEADER(CRTP_PORT_PARAM, TOC_CH);
       p.data[0]=CMD_GET_ITEM;
       p.data[1]=n;
-      p.data[2]=params[ptr].type;
+      p.data[2]=paramGetTocType(ptr);
       p.size=3+2+strlen(group)+strlen(params[ptr].name);
       ASSERT(p.size <= CRTP_MAX_DATA_SIZE); // Too long! The name of the group or the parameter may be too long.
       memcpy(p.data+3, group, strlen(group)+1);
@@ -269,29 +369,15 @@ void paramTOCProcess(int command)
     break;
   case CMD_GET_ITEM_V2:  //Get param variable
     memcpy(&paramId, &p.data[1], 2);
-    for (ptr=0; ptr<paramsLen; ptr++) //Ptr points a group
-    {
-      if (params[ptr].type & PARAM_GROUP)
-      {
-        if (params[ptr].type & PARAM_START)
-          group = params[ptr].name;
-        else
-          group = "";
-      }
-      else                          //Ptr points a variable
-      {
-        if (n==paramId)
-          break;
-        n++;
-      }
-    }
+    ptr = tocIndexGetEntry(&paramsIndex, paramId);
 
-    if (ptr<paramsLen)
+    if (ptr >= 0)
     {
+      group = params[tocIndexGetGroup(&paramsIndex, paramId)].name;
       p.header=CRTP_HEADER(CRTP_PORT_PARAM, TOC_CH);
       p.data[0]=CMD_GET_ITEM_V2;
       memcpy(&p.data[1], &paramId, 2);
-      p.data[3]=params[ptr].type;
+      p.data[3]=paramGetTocType(ptr);
       p.size=4+2+strlen(group)+strlen(params[ptr].name);
       ASSERT(p.size <= CRTP_MAX_DATA_SIZE); // Too long! The name of the group or the parameter may be too long.
       memcpy(p.data+4, group, strlen(group)+1);
@@ -307,14 +393,209 @@ void paramTOCProcess(int command)
   }
 }
 
+static int paramSize(uint8_t type)
+{
+  return 1 << (type & PARAM_BYTES_MASK);
+}
+
+// Store a value from a packet, with one store for variables of up to 4 bytes
+static void paramStore(int id, const uint8_t* src)
+{
+  switch (params[id].type & PARAM_BYTES_MASK)
+  {
+    case PARAM_1BYTE:
+      *(uint8_t*)params[id].address = *src;
+      break;
+    case PARAM_2BYTES:
+    {
+      uint16_t v;
+      memcpy(&v, src, sizeof(v));
+      *(uint16_t*)params[id].address = v;
+      break;
+    }
+    case PARAM_4BYTES:
+    {
+      uint32_t v;
+      memcpy(&v, src, sizeof(v));
+      *(uint32_t*)params[id].address = v;
+      break;
+    }
+    case PARAM_8BYTES:
+    {
+      uint64_t v;
+      memcpy(&v, src, sizeof(v));
+      *(uint64_t*)params[id].address = v;
+      break;
+    }
+  }
+}
+
+/* Transactions. While a transaction is open the writes of all the commands
+ * are staged instead of stored, reads return the current values. At commit
+ * the stabilizer loop stores all the staged values at the top of its next
+ * run, and then calls the change callbacks of the variables, so that the
+ * controllers never see a part of the change. The param task waits for the
+ * commit to be applied before answering.
+ * A write outside of a transaction to a variable with a change callback is
+ * committed the same way, as a transaction of one write. */
+static void paramApplyStaged(void)
+{
+  for (int i = 0; i < stagedCount; i++) {
+    paramStore(staged[i].id, staged[i].value);
+  }
+}
+
+static void paramNotifyStaged(void)
+{
+  for (int i = 0; i < stagedCount; i++) {
+    for (int c = 0; c < callbackCount; c++) {
+      if (callbacks[c].id == staged[i].id) {
+        callbacks[c].callback();
+      }
+    }
+  }
+}
+
+// Take the pending commit, only one of the stabilizer loop and the param task
+// gets it
+static bool paramClaimCommit(void)
+{
+  bool isClaimed;
+
+  taskENTER_CRITICAL();
+  isClaimed = isCommitPending;
+  isCommitPending = false;
+  taskEXIT_CRITICAL();
+
+  return isClaimed;
+}
+
+void paramCommitTransaction(void)
+{
+  if (!isCommitPending || !paramClaimCommit()) {
+    return;
+  }
+
+  paramApplyStaged();
+  paramNotifyStaged();
+  xSemaphoreGive(commitDone);
+}
+
+static void paramTransactionBegin(void)
+{
+  stagedCount = 0;
+  isTransactionOpen = true;
+  transactionLastWrite = xTaskGetTickCount();
+}
+
+static bool paramHasCallback(int id)
+{
+  for (int c = 0; c < callbackCount; c++) {
+    if (callbacks[c].id == id) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// Have the staged writes applied by the stabilizer loop and wait for it
+static void paramCommitStaged(void)
+{
+  isCommitPending = true;
+
+  if (xSemaphoreTake(commitDone, M2T(PARAM_COMMIT_TIMEOUT_MS)) != pdTRUE) {
+    if (paramClaimCommit()) {
+      // The stabilizer loop is not running, apply the change from here
+      taskENTER_CRITICAL();
+      paramApplyStaged();
+      taskEXIT_CRITICAL();
+      paramNotifyStaged();
+    } else {
+      // The loop took the commit right at the timeout, wait for it to finish
+      xSemaphoreTake(commitDone, portMAX_DELAY);
+    }
+  }
+
+  stagedCount = 0;
+  isWriteToTrigger = true;
+}
+
+static int paramTransactionCommit(uint8_t* count)
+{
+  *count = 0;
+
+  if (!isTransactionOpen) {
+    return EINVAL;
+  }
+
+  isTransactionOpen = false;
+  *count = stagedCount;
+  if (stagedCount > 0) {
+    paramCommitStaged();
+  }
+
+  return 0;
+}
+
+static void paramTransactionAbort(void)
+{
+  isTransactionOpen = false;
+  stagedCount = 0;
+}
+
+static int paramStage(int id, const uint8_t* src)
+{
+  int i;
+
+  // A variable written twice is committed with the last value
+  for (i = 0; i < stagedCount; i++) {
+    if (staged[i].id == id) {
+      break;
+    }
+  }
+
+  if (i == stagedCount) {
+    if (stagedCount >= PARAM_TRANSACTION_MAX) {
+      return ENOMEM;
+    }
+    staged[i].id = id;
+    stagedCount++;
+  }
+
+  memcpy(staged[i].value, src, paramSize(params[id].type));
+  return 0;
+}
+
+// Store a value from a packet. It is staged if a transaction is open, and
+// committed by the stabilizer loop if the variable has a change callback.
+static int paramWrite(int id, const uint8_t* src)
+{
+  if (isTransactionOpen) {
+    transactionLastWrite = xTaskGetTickCount();
+    return paramStage(id, src);
+  }
+
+  if (paramHasCallback(id)) {
+    paramStage(id, src);
+    paramCommitStaged();
+  } else {
+    paramStore(id, src);
+    isWriteToTrigger = true;
+  }
+
+  return 0;
+}
+
 static void paramWriteProcess()
 {
   if (useV2) {
     uint16_t ident;
     memcpy(&ident, &p.data[0], 2);
 
-    void* valptr = &p.data[2];
+    const uint8_t* valptr = &p.data[2];
     int id;
+    int error;
 
     id = variableGetIndex(ident);
 
@@ -329,27 +610,18 @@ static void paramWriteProcess()
     if (params[id].type & PARAM_RONLY)
       return;
 
-    switch (params[id].type & PARAM_BYTES_MASK)
-    {
-    case PARAM_1BYTE:
-      *(uint8_t*)params[id].address = *(uint8_t*)valptr;
-      break;
-      case PARAM_2BYTES:
-        *(uint16_t*)params[id].address = *(uint16_t*)valptr;
-        break;
-    case PARAM_4BYTES:
-        *(uint32_t*)params[id].address = *(uint32_t*)valptr;
-        break;
-    case PARAM_8BYTES:
-        *(uint64_t*)params[id].address = *(uint64_t*)valptr;
-        break;
+    error = paramWrite(id, valptr);
+    if (error) {
+      p.data[2] = error;
+      p.size = 3;
     }
 
     crtpSendPacket(&p);
   } else {
     int ident = p.data[0];
-    void* valptr = &p.data[1];
+    const uint8_t* valptr = &p.data[1];
     int id;
+    int error;
 
     id = variableGetIndex(ident);
 
@@ -366,20 +638,12 @@ static void paramWriteProcess()
   	if (params[id].type & PARAM_RONLY)
   		return;
 
-    switch (params[id].type & PARAM_BYTES_MASK)
-    {
-   	case PARAM_1BYTE:
-   		*(uint8_t*)params[id].address = *(uint8_t*)valptr;
-   		break;
-      case PARAM_2BYTES:
-    	  *(uint16_t*)params[id].address = *(uint16_t*)valptr;
-        break;
-   	case PARAM_4BYTES:
-        *(uint32_t*)params[id].address = *(uint32_t*)valptr;
-        break;
-   	case PARAM_8BYTES:
-        *(uint64_t*)params[id].address = *(uint64_t*)valptr;
-        break;
+    error = paramWrite(id, valptr);
+    if (error) {
+      p.data[0] = -1;
+      p.data[1] = ident;
+      p.data[2] = error;
+      p.size = 3;
     }
 
     crtpSendPacket(&p);
@@ -387,30 +651,13 @@ static void paramWriteProcess()
 }
 
 static char paramWriteByNameProcess(char* group, char* name, int type, void *valptr) {
-  int ptr;
-  char *pgroup = "";
+  int ptr = variableGetIndex(tocIndexFindId(&paramsIndex, group, name));
 
-  for (ptr=0; ptr<paramsLen; ptr++) //Ptr points a group
-  {
-    if (params[ptr].type & PARAM_GROUP)
-    {
-      if (params[ptr].type & PARAM_START)
-        pgroup = params[ptr].name;
-      else
-        pgroup = "";
-    }
-    else                          //Ptr points a variable
-    {
-      if (!strcmp(params[ptr].name, name) && !strcmp(pgroup, group))
-        break;
-    }
-  }
-
-  if (ptr >= paramsLen) {
+  if (ptr < 0) {
     return ENOENT;
   }
 
-  if (type != params[ptr].type) {
+  if (type != paramGetTocType(ptr)) {
     return EINVAL;
   }
 
@@ -418,23 +665,107 @@ static char paramWriteByNameProcess(char* group, char* name, int type, void *val
     return EACCES;
   }
 
-  switch (params[ptr].type & PARAM_BYTES_MASK)
+  return paramWrite(ptr, valptr);
+}
+
+/* Batch commands, with 16 bit ids whatever the TOC version used by the client.
+ * Read:  [MISC_READ_BATCH][id]...
+ *        answer [MISC_READ_BATCH][count][error][value]...
+ * Write: [MISC_WRITE_BATCH][id][value]...
+ *        answer [MISC_WRITE_BATCH][count][error]
+ * Values have the size of the type of the variable. The items are handled in
+ * order until one fails, count is the number of items handled and error the
+ * reason of the failure, 0 if all were handled. */
+static void paramReadBatchProcess()
+{
+  uint8_t request[CRTP_MAX_DATA_SIZE];
+  int requestSize = p.size;
+  uint8_t count = 0;
+  int error = 0;
+
+  memcpy(request, p.data, requestSize);
+  p.size = 3;
+
+  for (int pos = 1; pos < requestSize; pos += 2)
   {
- 	case PARAM_1BYTE:
- 		*(uint8_t*)params[ptr].address = *(uint8_t*)valptr;
- 		break;
-    case PARAM_2BYTES:
-  	  *(uint16_t*)params[ptr].address = *(uint16_t*)valptr;
+    uint16_t ident;
+    int id;
+
+    if (pos + 2 > requestSize) {
+      error = EINVAL;
       break;
- 	case PARAM_4BYTES:
-      *(uint32_t*)params[ptr].address = *(uint32_t*)valptr;
+    }
+
+    memcpy(&ident, &request[pos], 2);
+    id = variableGetIndex(ident);
+    if (id < 0) {
+      error = ENOENT;
       break;
- 	case PARAM_8BYTES:
-      *(uint64_t*)params[ptr].address = *(uint64_t*)valptr;
+    }
+
+    int size = paramSize(params[id].type);
+    if (p.size + size > CRTP_MAX_DATA_SIZE) {
+      // The client asks for the rest in a new packet
+      error = E2BIG;
       break;
+    }
+
+    memcpy(&p.data[p.size], params[id].address, size);
+    p.size += size;
+    count++;
   }
 
-  return 0;
+  p.data[1] = count;
+  p.data[2] = error;
+  crtpSendPacket(&p);
+}
+
+static void paramWriteBatchProcess()
+{
+  uint8_t count = 0;
+  int error = 0;
+  int pos = 1;
+
+  while (pos < p.size)
+  {
+    uint16_t ident;
+    int id;
+
+    if (pos + 2 > p.size) {
+      error = EINVAL;
+      break;
+    }
+
+    memcpy(&ident, &p.data[pos], 2);
+    id = variableGetIndex(ident);
+    if (id < 0) {
+      error = ENOENT;
+      break;
+    }
+
+    if (params[id].type & PARAM_RONLY) {
+      error = EACCES;
+      break;
+    }
+
+    int size = paramSize(params[id].type);
+    if (pos + 2 + size > p.size) {
+      error = EINVAL;
+      break;
+    }
+
+    error = paramWrite(id, &p.data[pos + 2]);
+    if (error) {
+      break;
+    }
+    pos += 2 + size;
+    count++;
+  }
+
+  p.data[1] = count;
+  p.data[2] = error;
+  p.size = 3;
+  crtpSendPacket(&p);
 }
 
 static void paramReadProcess()
@@ -514,21 +845,100 @@ static void paramReadProcess()
 
 static int variableGetIndex(int id)
 {
-  int i;
-  int n=0;
+  return tocIndexGetEntry(&paramsIndex, id);
+}
 
-  for (i=0; i<paramsLen; i++)
-  {
-    if(!(params[i].type & PARAM_GROUP))
-    {
-      if(n==id)
-        break;
-      n++;
+/* Persistent variables are stored by the CRC of their full name, so that
+ * the values are kept when the TOC changes. */
+static uint32_t paramGetKey(int id)
+{
+  char fullName[CRTP_MAX_DATA_SIZE];
+  const char* group = "";
+
+  // The group start is the closest one before the variable
+  for (int i = id; i >= 0; i--) {
+    if ((params[i].type & PARAM_GROUP) && (params[i].type & PARAM_START)) {
+      group = params[i].name;
+      break;
+    }
+  }
+
+  // The lengths are checked by paramInit()
+  int groupLength = strlen(group);
+  int nameLength = strlen(params[id].name);
+  memcpy(fullName, group, groupLength);
+  fullName[groupLength] = '.';
+  memcpy(&fullName[groupLength + 1], params[id].name, nameLength);
+
+  return crcSlow(fullName, groupLength + 1 + nameLength);
+}
+
+static void paramPersistentRestore(void)
+{
+  uint8_t value[8];
+  int restored = 0;
+
+  for (int i = 0; i < paramsLen; i++) {
+    if ((params[i].type & PARAM_GROUP) || !(params[i].type & PARAM_PERSISTENT)) {
+      continue;
+    }
+
+    if (paramStoreGet(paramGetKey(i), paramGetTocType(i), value, paramSize(params[i].type))) {
+      paramStore(i, value);
+      restored++;
     }
   }
 
-  if (i>=paramsLen)
-    return -1;
+  if (restored > 0) {
+    DEBUG_PRINT("Restored %d persistent parameters\n", restored);
+  }
+}
+
+static int paramPersistentStore(int id)
+{
+  uint8_t value[8];
+
+  if (!(params[id].type & PARAM_PERSISTENT)) {
+    return EINVAL;
+  }
+
+  memcpy(value, params[id].address, paramSize(params[id].type));
+  return paramStoreSet(paramGetKey(id), paramGetTocType(id), value, paramSize(params[id].type));
+}
+
+static int paramPersistentClear(int id)
+{
+  if (!(params[id].type & PARAM_PERSISTENT)) {
+    return EINVAL;
+  }
+
+  return paramStoreClear(paramGetKey(id));
+}
+
+/* Public API to access param TOC from within the copter */
+int paramGetVarId(char* group, char* name)
+{
+  return variableGetIndex(tocIndexFindId(&paramsIndex, group, name));
+}
 
-  return i;
+bool paramAddCallback(int varid, paramCallback_t callback)
+{
+  if (varid < 0 || varid >= paramsLen || callbackCount >= PARAM_MAX_CALLBACKS) {
+    return false;
+  }
+
+  callbacks[callbackCount].id = varid;
+  callbacks[callbackCount].callback = callback;
+  callbackCount++;
+  return true;
+}
+
+uint32_t paramTocImageSize(void)
+{
+  return tocIndexImageSize(&paramsIndex);
+}
+
+bool paramTocImageRead(uint32_t offset, uint8_t length, uint8_t* dest)
+{
+  return tocIndexImageRead(&paramsIndex, paramsCrc, offset, length, dest);
 }
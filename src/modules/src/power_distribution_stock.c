@@ -120,4 +120,5 @@ LOG_ADD(LOG_INT32, m4, &motorPower.m4)
 LOG_ADD(LOG_INT32, m1, &motorPower.m1)
 LOG_ADD(LOG_INT32, m2, &motorPower.m2)
 LOG_ADD(LOG_INT32, m3, &motorPower.m3)
+LOG_ADD_ARRAY(LOG_INT32, m, &motorPower, 4)
 LOG_GROUP_STOP(motor)
@@ -31,19 +31,28 @@
 #include "range.h"
 
 static uint16_t ranges[RANGE_T_END] = {0,};
+static uint32_t updateCounts[RANGE_T_END] = {0,};
 
 void rangeSet(rangeDirection_t direction, float range_m)
 {
   if (direction > (RANGE_T_END-1)) return;
 
   ranges[direction] = range_m * 1000;
+  updateCounts[direction]++;
 }
 
 float rangeGet(rangeDirection_t direction)
 {
     if (direction > (RANGE_T_END-1)) return 0;
 
-  return ranges[direction];
+  return ranges[direction] / 1000.0f;
+}
+
+uint32_t rangeGetUpdateCount(rangeDirection_t direction)
+{
+  if (direction > (RANGE_T_END-1)) return 0;
+
+  return updateCounts[direction];
 }
 
 LOG_GROUP_START(range)
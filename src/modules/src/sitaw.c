@@ -31,6 +31,7 @@
 #include "log.h"
 #include "param.h"
 #include "trigger.h"
+#include "flight_recorder.h"
 #include "sitaw.h"
 #include "commander.h"
 
@@ -138,6 +139,7 @@ static void sitAwPreThrustUpdateCallOut(setpoint_t *setpoint)
         setpoint->mode.y = modeDisable;
         setpoint->mode.z = modeDisable;
         setpoint->thrust = 0;
+        flightRecorderTrigger(flightRecorderTriggerTumble);
       }
 #endif
 
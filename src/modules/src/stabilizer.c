@@ -47,8 +47,11 @@
 #include "power_distribution.h"
 
 #include "estimator.h"
+#include "estimator_kalman.h"
 #include "usddeck.h"
 #include "quatcompress.h"
+#include "occupancy_grid.h"
+#include "flight_recorder.h"
 
 static bool isInit;
 static bool emergencyStop = false;
@@ -162,6 +165,24 @@ static void compressSetpoint()
   setpointCompressed.az = setpoint.acceleration.z * 1000.0f;
 }
 
+// Called by paramCommitTransaction() when a client writes stabilizer.estimator
+static void estimatorTypeChanged(void)
+{
+  if (estimatorType != getStateEstimator()) {
+    stateEstimatorInit(estimatorType);
+    estimatorType = getStateEstimator();
+  }
+}
+
+// Called by paramCommitTransaction() when a client writes stabilizer.controller
+static void controllerTypeChanged(void)
+{
+  if (controllerType != getControllerType()) {
+    controllerInit(controllerType);
+    controllerType = getControllerType();
+  }
+}
+
 void stabilizerInit(StateEstimatorType estimator)
 {
   if(isInit)
@@ -171,12 +192,17 @@ void stabilizerInit(StateEstimatorType estimator)
   stateEstimatorInit(estimator);
   controllerInit(ControllerTypeAny);
   powerDistributionInit();
+  flightRecorderInit();
   if (estimator == kalmanEstimator)
   {
     sitAwInit();
   }
   estimatorType = getStateEstimator();
   controllerType = getControllerType();
+  // allow to update the estimator and the controller dynamically
+  paramAddCallback(paramGetVarId("stabilizer", "estimator"), estimatorTypeChanged);
+  paramAddCallback(paramGetVarId("stabilizer", "controller"), controllerTypeChanged);
+  estimatorKalmanParamInit();
 
   xTaskCreate(stabilizerTask, STABILIZER_TASK_NAME,
               STABILIZER_TASK_STACKSIZE, NULL, STABILIZER_TASK_PRI, NULL);
@@ -203,6 +229,7 @@ static void checkEmergencyStopTimeout()
 
     if (emergencyStopTimeout == 0) {
       emergencyStop = true;
+      flightRecorderTrigger(flightRecorderTriggerEmergencyStop);
     }
   }
 }
@@ -237,6 +264,9 @@ static void stabilizerTask(void* param)
     // The sensor should unlock at 1kHz
     sensorsWaitDataReady();
 
+    // Parameters changed together are applied at the same point of the loop
+    paramCommitTransaction();
+
     if (startPropTest != false) {
       // TODO: What happens with estimator when we run tests after startup?
       testState = configureAcc;
@@ -247,19 +277,13 @@ static void stabilizerTask(void* param)
       sensorsAcquire(&sensorData, tick);
       testProps(&sensorData);
     } else {
-      // allow to update estimator dynamically
-      if (getStateEstimator() != estimatorType) {
-        stateEstimatorInit(estimatorType);
-        estimatorType = getStateEstimator();
-      }
-      // allow to update controller dynamically
-      if (getControllerType() != controllerType) {
-        controllerInit(controllerType);
-        controllerType = getControllerType();
-      }
-
       stateEstimator(&state, &sensorData, &control, tick);
       compressState();
+
+      // The occupancy grid needs a position estimate
+      if (estimatorType == kalmanEstimator && RATE_DO_EXECUTE(OCCUPANCY_GRID_UPDATE_RATE, tick)) {
+        occupancyGridUpdate(&state);
+      }
       
       commanderGetSetpoint(&setpoint, &state);
       compressSetpoint();
@@ -282,6 +306,9 @@ static void stabilizerTask(void* param)
           && RATE_DO_EXECUTE(usddeckFrequency(), tick)) {
         usddeckTriggerLogging();
       }
+
+      flightRecorderUpdate(tick);
+      logAggregationUpdate();
     }
     calcSensorToOutputLatency(&sensorData);
     tick++;
@@ -291,6 +318,7 @@ static void stabilizerTask(void* param)
 void stabilizerSetEmergencyStop()
 {
   emergencyStop = true;
+  flightRecorderTrigger(flightRecorderTriggerEmergencyStop);
 }
 
 void stabilizerResetEmergencyStop()
@@ -0,0 +1,255 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie Firmware
+ *
+ * Copyright (C) 2019 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * toc_index.c: Index for fast lookup of log and param variables by id and
+ *              by name
+ *
+ * The log and param tocs are tables placed in flash by the linker, with the
+ * variables of a group surrounded by group start and stop entries. The id of
+ * a variable is its position in the table when groups are not counted. The
+ * index maps ids to table entries in constant time, and names to ids with a
+ * binary search in a list of ids sorted on group and variable name.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "toc_index.h"
+
+// Context for the compare function of qsort(), only used while building the index
+static const tocIndex_t* sortIndex;
+
+static const char* getName(const tocIndex_t* index, int i)
+{
+  tocEntry_t entry;
+  index->getEntry(i, &entry);
+  return entry.name;
+}
+
+// Size of an entry in the toc image, group stops are not included
+static uint32_t getImageEntrySize(const tocEntry_t* entry)
+{
+  if (entry->kind == tocEntryGroupStop) {
+    return 0;
+  }
+
+  // Type, name and its terminating zero, and the element count of variables
+  uint32_t size = 1 + strlen(entry->name) + 1;
+  if (entry->kind == tocEntryVariable) {
+    size++;
+  }
+
+  return size;
+}
+
+static int compareNames(const tocIndex_t* index, int id, const char* group, const char* name)
+{
+  int result = strcmp(getName(index, index->groups[id]), group);
+  if (result == 0) {
+    result = strcmp(getName(index, index->entries[id]), name);
+  }
+
+  return result;
+}
+
+static int compareIds(const void* a, const void* b)
+{
+  int idA = *(const uint16_t*)a;
+  int idB = *(const uint16_t*)b;
+
+  int result = compareNames(sortIndex, idA,
+    getName(sortIndex, sortIndex->groups[idB]), getName(sortIndex, sortIndex->entries[idB]));
+
+  // Keep the toc order for duplicated names
+  if (result == 0) {
+    result = idA - idB;
+  }
+
+  return result;
+}
+
+int tocIndexCountVariables(int len, tocIndexGetEntry_t getEntry)
+{
+  int count = 0;
+
+  for (int i = 0; i < len; i++) {
+    tocEntry_t entry;
+    getEntry(i, &entry);
+    if (entry.kind == tocEntryVariable) {
+      count++;
+    }
+  }
+
+  return count;
+}
+
+void tocIndexInit(tocIndex_t* index, int len, tocIndexGetEntry_t getEntry, uint16_t* storage)
+{
+  int count = tocIndexCountVariables(len, getEntry);
+
+  index->len = len;
+  index->count = count;
+  index->entries = storage;
+  index->groups = storage + count;
+  index->sorted = storage + 2 * count;
+  index->getEntry = getEntry;
+
+  index->imageSize = TOC_IMAGE_HEADER_SIZE;
+  index->imageEntry = 0;
+  index->imageOffset = TOC_IMAGE_HEADER_SIZE;
+
+  int group = 0;
+  int id = 0;
+  for (int i = 0; i < len; i++) {
+    tocEntry_t entry;
+    getEntry(i, &entry);
+    if (entry.kind == tocEntryGroupStart) {
+      group = i;
+    } else if (entry.kind == tocEntryVariable) {
+      index->entries[id] = i;
+      index->groups[id] = group;
+      index->sorted[id] = id;
+      id++;
+    }
+    index->imageSize += getImageEntrySize(&entry);
+  }
+
+  sortIndex = index;
+  qsort(index->sorted, count, sizeof(index->sorted[0]), compareIds);
+  sortIndex = NULL;
+}
+
+int tocIndexGetEntry(const tocIndex_t* index, int id)
+{
+  if (id < 0 || id >= index->count) {
+    return -1;
+  }
+
+  return index->entries[id];
+}
+
+int tocIndexGetGroup(const tocIndex_t* index, int id)
+{
+  if (id < 0 || id >= index->count) {
+    return -1;
+  }
+
+  return index->groups[id];
+}
+
+int tocIndexFindId(const tocIndex_t* index, const char* group, const char* name)
+{
+  // Find the first id that is not less than group.name
+  int low = 0;
+  int high = index->count;
+  while (low < high) {
+    int mid = (low + high) / 2;
+    if (compareNames(index, index->sorted[mid], group, name) < 0) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+
+  if (low < index->count && compareNames(index, index->sorted[low], group, name) == 0) {
+    return index->sorted[low];
+  }
+
+  return -1;
+}
+
+uint32_t tocIndexImageSize(const tocIndex_t* index)
+{
+  return index->imageSize;
+}
+
+bool tocIndexImageRead(tocIndex_t* index, uint32_t crc, uint32_t offset, uint8_t length, uint8_t* dest)
+{
+  if (offset + length > index->imageSize) {
+    return false;
+  }
+
+  if (offset < TOC_IMAGE_HEADER_SIZE) {
+    uint8_t header[TOC_IMAGE_HEADER_SIZE];
+    header[0] = TOC_IMAGE_VERSION;
+    memcpy(&header[1], &index->count, 2);
+    memcpy(&header[3], &crc, 4);
+
+    uint32_t n = TOC_IMAGE_HEADER_SIZE - offset;
+    if (n > length) {
+      n = length;
+    }
+    memcpy(dest, &header[offset], n);
+    dest += n;
+    offset += n;
+    length -= n;
+  }
+
+  // Restart from the first entry when reading backwards
+  if (offset < index->imageOffset) {
+    index->imageEntry = 0;
+    index->imageOffset = TOC_IMAGE_HEADER_SIZE;
+  }
+
+  while (length > 0) {
+    tocEntry_t entry;
+    index->getEntry(index->imageEntry, &entry);
+    uint32_t entrySize = getImageEntrySize(&entry);
+
+    if (offset >= index->imageOffset + entrySize) {
+      index->imageOffset += entrySize;
+      index->imageEntry++;
+      continue;
+    }
+
+    uint32_t pos = offset - index->imageOffset;
+    uint32_t nameEnd = 1 + strlen(entry.name) + 1;
+    if (pos == 0) {
+      *dest++ = entry.type;
+      offset++;
+      length--;
+      pos++;
+    }
+
+    // Name including the terminating zero
+    if (pos < nameEnd && length > 0) {
+      uint32_t n = nameEnd - pos;
+      if (n > length) {
+        n = length;
+      }
+      memcpy(dest, &entry.name[pos - 1], n);
+      dest += n;
+      offset += n;
+      length -= n;
+      pos += n;
+    }
+
+    if (pos < entrySize && length > 0) {
+      *dest++ = entry.count;
+      offset++;
+      length--;
+    }
+  }
+
+  return true;
+}
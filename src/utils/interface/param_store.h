@@ -0,0 +1,76 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2019 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * param_store.h - Persistent storage of parameter values in the eeprom
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Values of up to PARAM_STORE_MAX_SIZE bytes are stored by key in an append
+ * only log, in the part of the eeprom after the config block. The log area is
+ * split in two halves, the one with the newest generation is used. A record
+ * is only valid if its CRC, that includes the generation of its half,
+ * matches. When the half is full the latest record of each key is copied to
+ * the other half, and a header with the next generation is written last, so
+ * that an interrupted write or compaction leaves the old values in place.
+ */
+
+#define PARAM_STORE_START 0x1000
+#define PARAM_STORE_MAX_SIZE 8
+#define PARAM_STORE_MAX_KEYS 32
+
+/**
+ * Find the newest half and index the latest record of each key, in one scan
+ * of the log.
+ */
+void paramStoreInit(void);
+
+/**
+ * Read a stored value.
+ *
+ * @param key  Key of the value
+ * @param type  Type the value must have been stored with
+ * @param value  Buffer for the value
+ * @param size  Size of the value
+ * @return true if a value of the type and size was stored for the key
+ */
+bool paramStoreGet(uint32_t key, uint8_t type, void* value, int size);
+
+/**
+ * Store a value, it replaces any earlier value of the key.
+ *
+ * @return 0, ENOMEM if there are already PARAM_STORE_MAX_KEYS keys, EINVAL
+ *         for a too large value or EIO if the eeprom could not be written.
+ */
+int paramStoreSet(uint32_t key, uint8_t type, const void* value, int size);
+
+/**
+ * Remove the value of a key.
+ *
+ * @return 0 or EIO if the eeprom could not be written.
+ */
+int paramStoreClear(uint32_t key);
@@ -32,6 +32,7 @@
 #include "led.h"
 #include "motors.h"
 #include "debug.h"
+#include "flight_recorder.h"
 
 #define MAGIC_ASSERT_INDICATOR 0x2f8a001f
 
@@ -54,6 +55,7 @@ void assertFail(char *exp, char *file, int line)
 {
   portDISABLE_INTERRUPTS();
   storeAssertSnapshotData(file, line);
+  flightRecorderFreeze(flightRecorderTriggerAssert);
   DEBUG_PRINT("Assert failed %s:%d\n", file, line);
 
   motorsSetRatio(MOTOR_M1, 0);
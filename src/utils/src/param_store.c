@@ -0,0 +1,349 @@
+/**
+ *    ||          ____  _ __
+ * +------+      / __ )(_) /_______________ _____  ___
+ * | 0xBC |     / __  / / __/ ___/ ___/ __ `/_  / / _ \
+ * +------+    / /_/ / / /_/ /__/ /  / /_/ / / /_/  __/
+ *  ||  ||    /_____/_/\__/\___/_/   \__,_/ /___/\___/
+ *
+ * Crazyflie control firmware
+ *
+ * Copyright (C) 2019 Bitcraze AB
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, in version 3.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * param_store.c - Persistent storage of parameter values in the eeprom
+ */
+#define DEBUG_MODULE "PSTORE"
+
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "param_store.h"
+#include "eeprom.h"
+#include "crc.h"
+#include "debug.h"
+
+/* Each half starts with a header, the magic, the generation and the CRC of
+ * both, followed by a commit byte. A compaction clears the commit byte of
+ * the other half, writes its header with a generation newer than all
+ * headers, copies the records and sets the commit byte last. The newest
+ * committed half is used.
+ * Records are the key, the type, the size of the value, the value and the
+ * CRC of the generation and all the previous fields. A record of size 0
+ * removes the key. */
+#define MAGIC 0x50535431
+#define COMMITTED 0xA5
+#define HALF_SIZE ((EEPROM_SIZE - PARAM_STORE_START) / 2)
+#define COMMIT_OFFSET 12
+#define HEADER_SIZE 13
+#define NO_HALF -1
+
+typedef struct {
+  uint32_t magic;
+  uint32_t generation;
+  crc crc;
+} __attribute__((packed)) header_t;
+
+typedef struct {
+  uint32_t key;
+  uint8_t type;
+  uint8_t size;
+} __attribute__((packed)) recordHead_t;
+
+#define RECORD_SIZE(valueSize) (sizeof(recordHead_t) + (valueSize) + sizeof(crc))
+
+// Latest record of each key
+static struct {
+  uint32_t key;
+  uint16_t address;
+} entries[PARAM_STORE_MAX_KEYS];
+static int entryCount;
+
+static int activeHalf = NO_HALF;
+static uint32_t generation;
+static uint32_t newestGeneration;  // Of all the headers, committed or not
+static uint16_t logEnd;            // Address of the next record
+
+static uint16_t halfStart(int half)
+{
+  return PARAM_STORE_START + half * HALF_SIZE;
+}
+
+static uint16_t halfEnd(int half)
+{
+  return halfStart(half) + HALF_SIZE;
+}
+
+static crc recordCrc(uint32_t recordGeneration, const recordHead_t* head, const uint8_t* value)
+{
+  uint8_t buffer[sizeof(recordGeneration) + sizeof(*head) + PARAM_STORE_MAX_SIZE];
+
+  memcpy(buffer, &recordGeneration, sizeof(recordGeneration));
+  memcpy(&buffer[sizeof(recordGeneration)], head, sizeof(*head));
+  if (head->size > 0) {
+    memcpy(&buffer[sizeof(recordGeneration) + sizeof(*head)], value, head->size);
+  }
+
+  return crcSlow(buffer, sizeof(recordGeneration) + sizeof(*head) + head->size);
+}
+
+// Read the record at address, returns its size or 0 if there is no valid record
+static int readRecord(uint16_t address, uint16_t end, uint32_t recordGeneration,
+                      recordHead_t* head, uint8_t* value)
+{
+  crc recordCrcValue;
+
+  if (address + RECORD_SIZE(0) > end ||
+      !eepromReadBuffer((uint8_t*)head, address, sizeof(*head)) ||
+      head->size > PARAM_STORE_MAX_SIZE ||
+      address + RECORD_SIZE(head->size) > end) {
+    return 0;
+  }
+
+  address += sizeof(*head);
+  if ((head->size > 0 && !eepromReadBuffer(value, address, head->size)) ||
+      !eepromReadBuffer((uint8_t*)&recordCrcValue, address + head->size, sizeof(recordCrcValue)) ||
+      recordCrcValue != recordCrc(recordGeneration, head, value)) {
+    return 0;
+  }
+
+  return RECORD_SIZE(head->size);
+}
+
+static bool writeRecord(uint16_t address, uint32_t recordGeneration,
+                        const recordHead_t* head, const uint8_t* value)
+{
+  uint8_t buffer[RECORD_SIZE(PARAM_STORE_MAX_SIZE)];
+  crc recordCrcValue = recordCrc(recordGeneration, head, value);
+
+  memcpy(buffer, head, sizeof(*head));
+  if (head->size > 0) {
+    memcpy(&buffer[sizeof(*head)], value, head->size);
+  }
+  memcpy(&buffer[sizeof(*head) + head->size], &recordCrcValue, sizeof(recordCrcValue));
+
+  return eepromWriteBuffer(buffer, address, RECORD_SIZE(head->size));
+}
+
+static int findEntry(uint32_t key)
+{
+  for (int i = 0; i < entryCount; i++) {
+    if (entries[i].key == key) {
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+static void removeEntry(int i)
+{
+  entryCount--;
+  entries[i] = entries[entryCount];
+}
+
+// Make a record the latest of its key
+static void indexRecord(uint32_t key, uint8_t size, uint16_t address)
+{
+  int i = findEntry(key);
+
+  if (size == 0) {
+    if (i >= 0) {
+      removeEntry(i);
+    }
+    return;
+  }
+
+  if (i < 0) {
+    if (entryCount >= PARAM_STORE_MAX_KEYS) {
+      DEBUG_PRINT("Too many keys, value dropped\n");
+      return;
+    }
+    i = entryCount++;
+    entries[i].key = key;
+  }
+
+  entries[i].address = address;
+}
+
+// Returns true if the header of the half is valid, committed or not
+static bool readHeader(int half, uint32_t* headerGeneration, bool* isCommitted)
+{
+  header_t header;
+  uint8_t commit;
+
+  if (!eepromReadBuffer((uint8_t*)&header, halfStart(half), sizeof(header)) ||
+      !eepromReadBuffer(&commit, halfStart(half) + COMMIT_OFFSET, sizeof(commit)) ||
+      header.magic != MAGIC ||
+      header.crc != crcSlow(&header, offsetof(header_t, crc))) {
+    return false;
+  }
+
+  *headerGeneration = header.generation;
+  *isCommitted = (commit == COMMITTED);
+  return true;
+}
+
+void paramStoreInit(void)
+{
+  uint32_t headerGeneration;
+  bool isCommitted;
+  recordHead_t head;
+  uint8_t value[PARAM_STORE_MAX_SIZE];
+
+  activeHalf = NO_HALF;
+  generation = 0;
+  newestGeneration = 0;
+  entryCount = 0;
+
+  for (int half = 0; half < 2; half++) {
+    if (!readHeader(half, &headerGeneration, &isCommitted)) {
+      continue;
+    }
+
+    if ((int32_t)(headerGeneration - newestGeneration) > 0) {
+      newestGeneration = headerGeneration;
+    }
+
+    if (isCommitted && (activeHalf == NO_HALF || (int32_t)(headerGeneration - generation) > 0)) {
+      activeHalf = half;
+      generation = headerGeneration;
+    }
+  }
+
+  if (activeHalf == NO_HALF) {
+    return;
+  }
+
+  uint16_t address = halfStart(activeHalf) + HEADER_SIZE;
+  int size;
+  while ((size = readRecord(address, halfEnd(activeHalf), generation, &head, value)) > 0) {
+    indexRecord(head.key, head.size, address);
+    address += size;
+  }
+  logEnd = address;
+
+  DEBUG_PRINT("%d values, %d bytes used\n", entryCount, logEnd - halfStart(activeHalf));
+}
+
+// Copy the latest record of each key to the other half
+static bool compact(void)
+{
+  int target = (activeHalf == 0) ? 1 : 0;
+  uint32_t targetGeneration = newestGeneration + 1;
+  uint16_t newAddress[PARAM_STORE_MAX_KEYS];
+  header_t header = {.magic = MAGIC, .generation = targetGeneration};
+  uint8_t commit = 0;
+  recordHead_t head;
+  uint8_t value[PARAM_STORE_MAX_SIZE];
+
+  header.crc = crcSlow(&header, offsetof(header_t, crc));
+
+  // Uncommit first, the old commit byte must not validate the new header
+  if (!eepromWriteBuffer(&commit, halfStart(target) + COMMIT_OFFSET, sizeof(commit)) ||
+      !eepromWriteBuffer((uint8_t*)&header, halfStart(target), sizeof(header))) {
+    return false;
+  }
+  newestGeneration = targetGeneration;
+
+  uint16_t address = halfStart(target) + HEADER_SIZE;
+  for (int i = 0; i < entryCount; i++) {
+    int size = readRecord(entries[i].address, halfEnd(activeHalf), generation, &head, value);
+    if (size == 0) {
+      // Unreadable, the value is lost
+      removeEntry(i--);
+      continue;
+    }
+
+    if (!writeRecord(address, targetGeneration, &head, value)) {
+      return false;
+    }
+    newAddress[i] = address;
+    address += size;
+  }
+
+  commit = COMMITTED;
+  if (!eepromWriteBuffer(&commit, halfStart(target) + COMMIT_OFFSET, sizeof(commit))) {
+    return false;
+  }
+
+  for (int i = 0; i < entryCount; i++) {
+    entries[i].address = newAddress[i];
+  }
+  activeHalf = target;
+  generation = targetGeneration;
+  logEnd = address;
+
+  return true;
+}
+
+static int append(const recordHead_t* head, const uint8_t* value)
+{
+  if (activeHalf == NO_HALF || logEnd + RECORD_SIZE(head->size) > halfEnd(activeHalf)) {
+    if (!compact()) {
+      return EIO;
+    }
+  }
+
+  // The live records of PARAM_STORE_MAX_KEYS keys always fit in a half
+  if (!writeRecord(logEnd, generation, head, value)) {
+    return EIO;
+  }
+
+  indexRecord(head->key, head->size, logEnd);
+  logEnd += RECORD_SIZE(head->size);
+  return 0;
+}
+
+bool paramStoreGet(uint32_t key, uint8_t type, void* value, int size)
+{
+  recordHead_t head;
+  uint8_t stored[PARAM_STORE_MAX_SIZE];
+  int i = findEntry(key);
+
+  if (i < 0 ||
+      readRecord(entries[i].address, halfEnd(activeHalf), generation, &head, stored) == 0 ||
+      head.type != type || head.size != size) {
+    return false;
+  }
+
+  memcpy(value, stored, size);
+  return true;
+}
+
+int paramStoreSet(uint32_t key, uint8_t type, const void* value, int size)
+{
+  recordHead_t head = {.key = key, .type = type, .size = size};
+
+  if (size <= 0 || size > PARAM_STORE_MAX_SIZE) {
+    return EINVAL;
+  }
+
+  if (findEntry(key) < 0 && entryCount >= PARAM_STORE_MAX_KEYS) {
+    return ENOMEM;
+  }
+
+  return append(&head, value);
+}
+
+int paramStoreClear(uint32_t key)
+{
+  recordHead_t head = {.key = key, .type = 0, .size = 0};
+
+  if (findEntry(key) < 0) {
+    return 0;
+  }
+
+  return append(&head, NULL);
+}
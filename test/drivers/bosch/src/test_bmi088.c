@@ -0,0 +1,219 @@
+// File under test
+// @MODULE "bmi088_accel.c"
+// @MODULE "bmi088_gyro.c"
+#include "bmi088.h"
+
+#include <stdio.h>
+#include <string.h>
+#include "unity.h"
+#include "sensorBusMocks.h"
+
+#define ACCEL_ADDR BMI088_ACCEL_I2C_ADDR_PRIMARY
+#define GYRO_ADDR BMI088_GYRO_I2C_ADDR_SECONDARY
+
+#define BENCHMARK_ITERATIONS 10000
+
+static struct bmi088_dev dev;
+
+static void fixtureSetAxes(uint8_t* regs, uint8_t firstReg, int16_t x, int16_t y, int16_t z);
+static void incrementingSampleModel(uint8_t devAddr, uint8_t regAddr, uint16_t len, uint8_t* regs, void* ctx);
+
+void setUp(void) {
+  sensorBusMockReset();
+
+  uint8_t* accelRegs = sensorBusMockAddDevice(ACCEL_ADDR, 0, 0);
+  accelRegs[BMI088_ACCEL_CHIP_ID_REG] = BMI088_ACCEL_CHIP_ID;
+  uint8_t* gyroRegs = sensorBusMockAddDevice(GYRO_ADDR, 0, 0);
+  gyroRegs[BMI088_GYRO_CHIP_ID_REG] = BMI088_GYRO_CHIP_ID;
+
+  // Same setup as in sensors_bmi088_bmp388.c
+  memset(&dev, 0, sizeof(dev));
+  dev.accel_id = ACCEL_ADDR;
+  dev.gyro_id = GYRO_ADDR;
+  dev.interface = BMI088_I2C_INTF;
+  dev.read = sensorBusMockBstdrRead;
+  dev.write = sensorBusMockBstdrWrite;
+  dev.delay_ms = sensorBusMockBstdrDelay;
+}
+
+void testThatAccelInitReadsChipId() {
+  // Fixture
+
+  // Test
+  uint16_t actual = bmi088_accel_init(&dev);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT16(BMI088_OK, actual);
+  TEST_ASSERT_EQUAL_UINT8(BMI088_ACCEL_CHIP_ID, dev.accel_chip_id);
+}
+
+void testThatGyroInitReadsChipId() {
+  // Fixture
+
+  // Test
+  uint16_t actual = bmi088_gyro_init(&dev);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT16(BMI088_OK, actual);
+  TEST_ASSERT_EQUAL_UINT8(BMI088_GYRO_CHIP_ID, dev.gyro_chip_id);
+}
+
+void testThatAccelInitFailsWhenDeviceDoesNotRespond() {
+  // Fixture
+  sensorBusMockSetFailing(ACCEL_ADDR, true);
+
+  // Test
+  uint16_t actual = bmi088_accel_init(&dev);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT16(BMI088_E_COM_FAIL, actual);
+}
+
+void testThatAccelDataIsParsed() {
+  // Fixture
+  bmi088_accel_init(&dev);
+  fixtureSetAxes(sensorBusMockGetRegisters(ACCEL_ADDR), BMI088_ACCEL_X_LSB_REG, 1234, -2, -32768);
+
+  // Test
+  struct bmi088_sensor_data actual;
+  uint16_t result = bmi088_get_accel_data(&actual, &dev);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT16(BMI088_OK, result);
+  TEST_ASSERT_EQUAL_INT16(1234, actual.x);
+  TEST_ASSERT_EQUAL_INT16(-2, actual.y);
+  TEST_ASSERT_EQUAL_INT16(-32768, actual.z);
+}
+
+void testThatGyroDataIsParsed() {
+  // Fixture
+  bmi088_gyro_init(&dev);
+  fixtureSetAxes(sensorBusMockGetRegisters(GYRO_ADDR), BMI088_GYRO_X_LSB_REG, -1, 32767, 17);
+
+  // Test
+  struct bmi088_sensor_data actual;
+  uint16_t result = bmi088_get_gyro_data(&actual, &dev);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT16(BMI088_OK, result);
+  TEST_ASSERT_EQUAL_INT16(-1, actual.x);
+  TEST_ASSERT_EQUAL_INT16(32767, actual.y);
+  TEST_ASSERT_EQUAL_INT16(17, actual.z);
+}
+
+void testThatAccelDataIsReadInOneBurst() {
+  // Fixture
+  bmi088_accel_init(&dev);
+  sensorBusMockClearStats();
+
+  // Test
+  struct bmi088_sensor_data actual;
+  bmi088_get_accel_data(&actual, &dev);
+
+  // Assert
+  const sensorBusMockStats_t* stats = sensorBusMockGetStats();
+  TEST_ASSERT_EQUAL_UINT32(1, stats->reads);
+  TEST_ASSERT_EQUAL_UINT32(6, stats->bytesRead);
+  TEST_ASSERT_EQUAL_UINT32(0, stats->writes);
+}
+
+void testThatRecordedGyroSamplesAreReplayed() {
+  // Fixture
+  const sensorBusMockTransaction_t recording[] = {
+    {sensorBusMockRead, GYRO_ADDR, BMI088_GYRO_CHIP_ID_REG, 1, {BMI088_GYRO_CHIP_ID}},
+    {sensorBusMockRead, GYRO_ADDR, BMI088_GYRO_X_LSB_REG, 6, {0x10, 0x00, 0xf0, 0xff, 0x00, 0x80}},
+    {sensorBusMockRead, GYRO_ADDR, BMI088_GYRO_X_LSB_REG, 6, {0x11, 0x00, 0xef, 0xff, 0x01, 0x80}},
+  };
+  sensorBusMockReplay(recording, sizeof(recording) / sizeof(recording[0]));
+
+  // Test
+  struct bmi088_sensor_data first;
+  struct bmi088_sensor_data second;
+  bmi088_gyro_init(&dev);
+  bmi088_get_gyro_data(&first, &dev);
+  bmi088_get_gyro_data(&second, &dev);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT32(0, sensorBusMockReplayRemaining());
+  TEST_ASSERT_EQUAL_INT16(16, first.x);
+  TEST_ASSERT_EQUAL_INT16(-16, first.y);
+  TEST_ASSERT_EQUAL_INT16(-32768, first.z);
+  TEST_ASSERT_EQUAL_INT16(17, second.x);
+  TEST_ASSERT_EQUAL_INT16(-17, second.y);
+  TEST_ASSERT_EQUAL_INT16(-32767, second.z);
+}
+
+void testThatRecordingCanBeReplayed() {
+  // Fixture
+  sensorBusMockTransaction_t recording[4];
+  sensorBusMockRecord(recording, 4);
+  bmi088_accel_init(&dev);
+  fixtureSetAxes(sensorBusMockGetRegisters(ACCEL_ADDR), BMI088_ACCEL_X_LSB_REG, 100, 200, 300);
+  struct bmi088_sensor_data recorded;
+  bmi088_get_accel_data(&recorded, &dev);
+  uint32_t recordedCount = sensorBusMockRecordedCount();
+
+  sensorBusMockReset();
+  sensorBusMockReplay(recording, recordedCount);
+
+  // Test
+  struct bmi088_sensor_data actual;
+  bmi088_accel_init(&dev);
+  bmi088_get_accel_data(&actual, &dev);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT32(2, recordedCount);
+  TEST_ASSERT_EQUAL_UINT32(0, sensorBusMockReplayRemaining());
+  TEST_ASSERT_EQUAL_INT16(recorded.x, actual.x);
+  TEST_ASSERT_EQUAL_INT16(recorded.y, actual.y);
+  TEST_ASSERT_EQUAL_INT16(recorded.z, actual.z);
+}
+
+void testBenchmarkAccelAndGyroReadPath() {
+  // Fixture
+  sensorBusMockReset();
+  sensorBusMockAddDevice(ACCEL_ADDR, incrementingSampleModel, 0)[BMI088_ACCEL_CHIP_ID_REG] = BMI088_ACCEL_CHIP_ID;
+  sensorBusMockAddDevice(GYRO_ADDR, incrementingSampleModel, 0)[BMI088_GYRO_CHIP_ID_REG] = BMI088_GYRO_CHIP_ID;
+  bmi088_accel_init(&dev);
+  bmi088_gyro_init(&dev);
+  sensorBusMockClearStats();
+
+  struct bmi088_sensor_data acc;
+  struct bmi088_sensor_data gyro;
+
+  // Test
+  uint64_t start = sensorBusMockNowNs();
+  for (int i = 0; i < BENCHMARK_ITERATIONS; i++) {
+    bmi088_get_accel_data(&acc, &dev);
+    bmi088_get_gyro_data(&gyro, &dev);
+  }
+  uint64_t duration = sensorBusMockNowNs() - start;
+
+  // Assert
+  const sensorBusMockStats_t* stats = sensorBusMockGetStats();
+  printf("bmi088 read path: %.1f ns per accel + gyro sample, %u bus transactions\n",
+    (double)duration / BENCHMARK_ITERATIONS, (unsigned)(stats->reads + stats->writes));
+
+  TEST_ASSERT_EQUAL_UINT32(2 * BENCHMARK_ITERATIONS, stats->reads);
+  TEST_ASSERT_EQUAL_UINT32(0, stats->writes);
+  TEST_ASSERT_EQUAL_INT16((int16_t)BENCHMARK_ITERATIONS, gyro.x);
+}
+
+// Helpers ////////////////////////////////////////////////
+
+static void fixtureSetAxes(uint8_t* regs, uint8_t firstReg, int16_t x, int16_t y, int16_t z) {
+  int16_t axes[] = {x, y, z};
+  for (int i = 0; i < 3; i++) {
+    regs[firstReg + i * 2] = (uint16_t)axes[i] & 0xff;
+    regs[firstReg + i * 2 + 1] = (uint16_t)axes[i] >> 8;
+  }
+}
+
+// Synthetic device producing a new sample, with an incremented value on all axes, for every data read
+static void incrementingSampleModel(uint8_t devAddr, uint8_t regAddr, uint16_t len, uint8_t* regs, void* ctx) {
+  uint8_t dataReg = (devAddr == ACCEL_ADDR) ? BMI088_ACCEL_X_LSB_REG : BMI088_GYRO_X_LSB_REG;
+  if (regAddr == dataReg) {
+    int16_t value = (int16_t)(regs[dataReg] | (regs[dataReg + 1] << 8)) + 1;
+    fixtureSetAxes(regs, dataReg, value, value, value);
+  }
+}
@@ -0,0 +1,150 @@
+// File under test
+#include "bmp3.h"
+
+#include <stdio.h>
+#include <string.h>
+#include "unity.h"
+#include "sensorBusMocks.h"
+
+#define BARO_ADDR BMP3_I2C_ADDR_SEC
+
+#define BENCHMARK_ITERATIONS 10000
+
+static struct bmp3_dev dev;
+static uint8_t* regs;
+
+static void fixtureSetRawData(uint32_t pressure, uint32_t temperature);
+
+void setUp(void) {
+  sensorBusMockReset();
+
+  regs = sensorBusMockAddDevice(BARO_ADDR, 0, 0);
+  regs[BMP3_CHIP_ID_ADDR] = BMP3_CHIP_ID;
+  regs[BMP3_SENS_STATUS_REG_ADDR] = BMP3_CMD_RDY;
+
+  // Temperature trimming, par_t1 = 27000, par_t2 = 19000, par_t3 = 0
+  regs[BMP3_CALIB_DATA_ADDR + 0] = 0x78;
+  regs[BMP3_CALIB_DATA_ADDR + 1] = 0x69;
+  regs[BMP3_CALIB_DATA_ADDR + 2] = 0x38;
+  regs[BMP3_CALIB_DATA_ADDR + 3] = 0x4a;
+
+  // Same setup as in sensors_bmi088_bmp388.c
+  memset(&dev, 0, sizeof(dev));
+  dev.dev_id = BARO_ADDR;
+  dev.intf = BMP3_I2C_INTF;
+  dev.read = sensorBusMockBstdrRead;
+  dev.write = sensorBusMockBstdrWrite;
+  dev.delay_ms = sensorBusMockBstdrDelay;
+}
+
+void testThatInitResetsTheSensorAndReadsCalibration() {
+  // Fixture
+
+  // Test
+  int8_t actual = bmp3_init(&dev);
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT8(BMP3_OK, actual);
+  TEST_ASSERT_EQUAL_HEX8(0xB6, regs[BMP3_CMD_ADDR]);
+  TEST_ASSERT_EQUAL_UINT16(27000, dev.calib_data.reg_calib_data.par_t1);
+  TEST_ASSERT_EQUAL_UINT16(19000, dev.calib_data.reg_calib_data.par_t2);
+}
+
+void testThatInitFailsOnWrongChipId() {
+  // Fixture
+  regs[BMP3_CHIP_ID_ADDR] = 0x42;
+
+  // Test
+  int8_t actual = bmp3_init(&dev);
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT8(BMP3_E_DEV_NOT_FOUND, actual);
+}
+
+void testThatInitUsesExpectedBusTransactions() {
+  // Fixture
+  const sensorBusMockTransaction_t recording[] = {
+    {sensorBusMockRead, BARO_ADDR, BMP3_CHIP_ID_ADDR, 1, {BMP3_CHIP_ID}},
+    {sensorBusMockRead, BARO_ADDR, BMP3_SENS_STATUS_REG_ADDR, 1, {BMP3_CMD_RDY}},
+    {sensorBusMockWrite, BARO_ADDR, BMP3_CMD_ADDR, 1, {0xB6}},
+    {sensorBusMockRead, BARO_ADDR, BMP3_ERR_REG_ADDR, 1, {0}},
+    {sensorBusMockRead, BARO_ADDR, BMP3_CALIB_DATA_ADDR, BMP3_CALIB_DATA_LEN, {0x78, 0x69, 0x38, 0x4a}},
+  };
+  sensorBusMockReplay(recording, sizeof(recording) / sizeof(recording[0]));
+
+  // Test
+  int8_t actual = bmp3_init(&dev);
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT8(BMP3_OK, actual);
+  TEST_ASSERT_EQUAL_UINT32(0, sensorBusMockReplayRemaining());
+  TEST_ASSERT_EQUAL_UINT32(2, sensorBusMockGetStats()->delayMs);
+}
+
+void testThatTemperatureIsCompensated() {
+  // Fixture
+  bmp3_init(&dev);
+  fixtureSetRawData(0, 8000000);
+
+  // (8000000 - 27000 * 2^8) * 19000 / 2^30
+  float expected = 19.2525f;
+
+  // Test
+  struct bmp3_data actual;
+  int8_t result = bmp3_get_sensor_data(BMP3_TEMP, &actual, &dev);
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT8(BMP3_OK, result);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, expected, actual.temperature);
+}
+
+void testThatSensorDataIsReadInOneBurst() {
+  // Fixture
+  bmp3_init(&dev);
+  sensorBusMockClearStats();
+
+  // Test
+  struct bmp3_data actual;
+  bmp3_get_sensor_data(BMP3_ALL, &actual, &dev);
+
+  // Assert
+  const sensorBusMockStats_t* stats = sensorBusMockGetStats();
+  TEST_ASSERT_EQUAL_UINT32(1, stats->reads);
+  TEST_ASSERT_EQUAL_UINT32(BMP3_P_T_DATA_LEN, stats->bytesRead);
+  TEST_ASSERT_EQUAL_UINT32(0, stats->writes);
+}
+
+void testBenchmarkReadAndCompensate() {
+  // Fixture
+  bmp3_init(&dev);
+  fixtureSetRawData(6500000, 8000000);
+  sensorBusMockClearStats();
+
+  struct bmp3_data data;
+
+  // Test
+  uint64_t start = sensorBusMockNowNs();
+  for (int i = 0; i < BENCHMARK_ITERATIONS; i++) {
+    bmp3_get_sensor_data(BMP3_ALL, &data, &dev);
+  }
+  uint64_t duration = sensorBusMockNowNs() - start;
+
+  // Assert
+  const sensorBusMockStats_t* stats = sensorBusMockGetStats();
+  printf("bmp3 read path: %.1f ns per sample, %u bus transactions\n",
+    (double)duration / BENCHMARK_ITERATIONS, (unsigned)(stats->reads + stats->writes));
+
+  TEST_ASSERT_EQUAL_UINT32(BENCHMARK_ITERATIONS, stats->reads);
+  TEST_ASSERT_EQUAL_UINT32(0, stats->writes);
+}
+
+// Helpers ////////////////////////////////////////////////
+
+static void fixtureSetRawData(uint32_t pressure, uint32_t temperature) {
+  regs[BMP3_DATA_ADDR + 0] = pressure & 0xff;
+  regs[BMP3_DATA_ADDR + 1] = (pressure >> 8) & 0xff;
+  regs[BMP3_DATA_ADDR + 2] = (pressure >> 16) & 0xff;
+  regs[BMP3_DATA_ADDR + 3] = temperature & 0xff;
+  regs[BMP3_DATA_ADDR + 4] = (temperature >> 8) & 0xff;
+  regs[BMP3_DATA_ADDR + 5] = (temperature >> 16) & 0xff;
+}
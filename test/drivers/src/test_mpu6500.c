@@ -0,0 +1,172 @@
+// File under test
+#include "mpu6500.h"
+
+// @MODULE "i2cdev_f405.c"
+#include "i2cdev.h" // @NO_MODULE
+
+#include <stdio.h>
+#include <string.h>
+#include "unity.h"
+#include "mock_console.h"
+#include "eprintf.h"
+#include "freertosMocks.h"
+#include "i2cdrvMocks.h"
+#include "sensorBusMocks.h"
+
+#define MPU_ADDR MPU6500_ADDRESS_AD0_HIGH
+
+#define BENCHMARK_ITERATIONS 10000
+
+static uint8_t* regs;
+
+void setUp(void) {
+  sensorBusMockReset();
+  regs = sensorBusMockAddDevice(MPU_ADDR, 0, 0);
+
+  mpu6500Init(I2C3_DEV);
+  // Start every test with an empty register cache
+  mpu6500Reset();
+  sensorBusMockClearStats();
+}
+
+void testThatConnectionIsVerifiedUsingWhoAmI() {
+  // Fixture
+  regs[MPU6500_RA_WHO_AM_I] = 0x71;
+
+  // Test
+  bool actual = mpu6500TestConnection();
+
+  // Assert
+  TEST_ASSERT_TRUE(actual);
+}
+
+void testThatConnectionFailsForUnknownDevice() {
+  // Fixture
+  regs[MPU6500_RA_WHO_AM_I] = 0x00;
+
+  // Test
+  bool actual = mpu6500TestConnection();
+
+  // Assert
+  TEST_ASSERT_FALSE(actual);
+}
+
+void testThatMotion6IsParsedFromOneBurst() {
+  // Fixture
+  const uint8_t sample[14] = {
+    0x12, 0x34, 0xff, 0xfe, 0x80, 0x00, // Accel
+    0x00, 0x00,                         // Temperature
+    0x00, 0x01, 0x7f, 0xff, 0xc0, 0x00, // Gyro
+  };
+  memcpy(&regs[MPU6500_RA_ACCEL_XOUT_H], sample, sizeof(sample));
+  int16_t ax, ay, az, gx, gy, gz;
+
+  // Test
+  mpu6500GetMotion6(&ax, &ay, &az, &gx, &gy, &gz);
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT16(0x1234, ax);
+  TEST_ASSERT_EQUAL_INT16(-2, ay);
+  TEST_ASSERT_EQUAL_INT16(-32768, az);
+  TEST_ASSERT_EQUAL_INT16(1, gx);
+  TEST_ASSERT_EQUAL_INT16(32767, gy);
+  TEST_ASSERT_EQUAL_INT16(-16384, gz);
+
+  const sensorBusMockStats_t* stats = sensorBusMockGetStats();
+  TEST_ASSERT_EQUAL_UINT32(1, stats->reads);
+  TEST_ASSERT_EQUAL_UINT32(14, stats->bytesRead);
+}
+
+void testThatSettingGyroRangeKeepsOtherBits() {
+  // Fixture
+  regs[MPU6500_RA_GYRO_CONFIG] = 0xe1;
+
+  // Test
+  mpu6500SetFullScaleGyroRange(MPU6500_GYRO_FS_2000);
+
+  // Assert
+  TEST_ASSERT_EQUAL_HEX8(0xf9, regs[MPU6500_RA_GYRO_CONFIG]);
+}
+
+void testThatSettingGyroRangeReadsBeforeWriteWhenNotCached() {
+  // Fixture
+  const sensorBusMockTransaction_t recording[] = {
+    {sensorBusMockRead, MPU_ADDR, MPU6500_RA_GYRO_CONFIG, 1, {0x00}},
+    {sensorBusMockWrite, MPU_ADDR, MPU6500_RA_GYRO_CONFIG, 1, {0x18}},
+  };
+  sensorBusMockReplay(recording, sizeof(recording) / sizeof(recording[0]));
+
+  // Test
+  mpu6500SetFullScaleGyroRange(MPU6500_GYRO_FS_2000);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT32(0, sensorBusMockReplayRemaining());
+}
+
+void testThatSettingCachedRegisterIsASingleWrite() {
+  // Fixture
+  regs[MPU6500_RA_GYRO_CONFIG] = 0xe1;
+  mpu6500SetFullScaleGyroRange(MPU6500_GYRO_FS_2000);
+  sensorBusMockClearStats();
+
+  // Test
+  mpu6500SetFullScaleGyroRange(MPU6500_GYRO_FS_250);
+  uint8_t actual = mpu6500GetFullScaleGyroRangeId();
+
+  // Assert
+  TEST_ASSERT_EQUAL_HEX8(0xe1, regs[MPU6500_RA_GYRO_CONFIG]);
+  TEST_ASSERT_EQUAL_UINT8(MPU6500_GYRO_FS_250, actual);
+
+  const sensorBusMockStats_t* stats = sensorBusMockGetStats();
+  TEST_ASSERT_EQUAL_UINT32(0, stats->reads);
+  TEST_ASSERT_EQUAL_UINT32(1, stats->writes);
+}
+
+void testThatVolatileRegisterIsAlwaysReadBeforeWrite() {
+  // Fixture
+  mpu6500SetSleepEnabled(false);
+  sensorBusMockClearStats();
+
+  // Test
+  mpu6500SetSleepEnabled(true);
+
+  // Assert
+  const sensorBusMockStats_t* stats = sensorBusMockGetStats();
+  TEST_ASSERT_EQUAL_UINT32(1, stats->reads);
+  TEST_ASSERT_EQUAL_UINT32(1, stats->writes);
+}
+
+void testThatResetInvalidatesTheCache() {
+  // Fixture
+  mpu6500SetFullScaleGyroRange(MPU6500_GYRO_FS_2000);
+  mpu6500Reset();
+  regs[MPU6500_RA_GYRO_CONFIG] = 0x00;
+  sensorBusMockClearStats();
+
+  // Test
+  uint8_t actual = mpu6500GetFullScaleGyroRangeId();
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT8(0, actual);
+  TEST_ASSERT_EQUAL_UINT32(1, sensorBusMockGetStats()->reads);
+}
+
+void testBenchmarkMotion6ReadPath() {
+  // Fixture
+  int16_t ax, ay, az, gx, gy, gz;
+
+  // Test
+  uint64_t start = sensorBusMockNowNs();
+  for (int i = 0; i < BENCHMARK_ITERATIONS; i++) {
+    mpu6500GetMotion6(&ax, &ay, &az, &gx, &gy, &gz);
+  }
+  uint64_t duration = sensorBusMockNowNs() - start;
+
+  // Assert
+  const sensorBusMockStats_t* stats = sensorBusMockGetStats();
+  printf("mpu6500 read path: %.1f ns per sample, %u bus transactions\n",
+    (double)duration / BENCHMARK_ITERATIONS, (unsigned)(stats->reads + stats->writes));
+
+  TEST_ASSERT_EQUAL_UINT32(BENCHMARK_ITERATIONS, stats->reads);
+  TEST_ASSERT_EQUAL_UINT32(0, stats->writes);
+}
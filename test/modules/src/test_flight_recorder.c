@@ -0,0 +1,220 @@
+// File under test flight_recorder.c
+#include "flight_recorder.h"
+
+#include <string.h>
+#include "unity.h"
+#include "mock_log.h"
+#include "crc.h"
+
+#define STATE_OFFSET 1
+#define CONFIG_OFFSET 12
+
+static uint16_t var16;
+static float varFloat;
+
+static int logGetVarIdFromTocCallback(int tocId, int cmock_num_calls);
+static void* logGetAddressCallback(int varid, int cmock_num_calls);
+static int logGetTypeCallback(int varid, int cmock_num_calls);
+static uint8_t logVarSizeCallback(int type, int cmock_num_calls);
+
+static void fixtureConfigure(uint8_t triggerMask, uint8_t postPercent);
+static void fixtureArm();
+static uint8_t readState();
+static uint16_t readUint16(uint32_t offset);
+static void recordTicks(uint32_t firstTick, int count);
+
+void setUp(void) {
+  logGetVarIdFromToc_StubWithCallback(logGetVarIdFromTocCallback);
+  logGetAddress_StubWithCallback(logGetAddressCallback);
+  logGetType_StubWithCallback(logGetTypeCallback);
+  logVarSize_StubWithCallback(logVarSizeCallback);
+
+  flightRecorderInit();
+  uint8_t off = flightRecorderStateOff;
+  flightRecorderMemWrite(STATE_OFFSET, 1, &off);
+}
+
+void tearDown(void) {
+  // Empty
+}
+
+void testThatArmingStartsRecording() {
+  // Fixture
+  fixtureConfigure(0xff, 20);
+
+  // Test
+  fixtureArm();
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT8(flightRecorderStateRecording, readState());
+}
+
+void testThatArmingFailsForUnknownVariable() {
+  // Fixture
+  fixtureConfigure(0xff, 20);
+  uint16_t unknownId = 99;
+  flightRecorderMemWrite(CONFIG_OFFSET + 4, sizeof(unknownId), (uint8_t*)&unknownId);
+
+  // Test
+  uint8_t recording = flightRecorderStateRecording;
+  bool actual = flightRecorderMemWrite(STATE_OFFSET, 1, &recording);
+
+  // Assert
+  TEST_ASSERT_FALSE(actual);
+  TEST_ASSERT_EQUAL_UINT8(flightRecorderStateOff, readState());
+}
+
+void testThatConfigurationCanNotBeWrittenWhileRecording() {
+  // Fixture
+  fixtureConfigure(0xff, 20);
+  fixtureArm();
+
+  // Test
+  uint8_t divider = 2;
+  bool actual = flightRecorderMemWrite(CONFIG_OFFSET + 1, 1, &divider);
+
+  // Assert
+  TEST_ASSERT_FALSE(actual);
+}
+
+void testThatFramesCanNotBeReadWhileRecording() {
+  // Fixture
+  fixtureConfigure(0xff, 20);
+  fixtureArm();
+  recordTicks(1, 10);
+
+  // Test
+  uint8_t frame[10];
+  bool actual = flightRecorderMemRead(FLIGHT_RECORDER_HEADER_SIZE, sizeof(frame), frame);
+
+  // Assert
+  TEST_ASSERT_FALSE(actual);
+}
+
+void testThatWindowIsFrozenAfterThePostTriggerFrames() {
+  // Fixture
+  fixtureConfigure(0xff, 0);
+  fixtureArm();
+  recordTicks(1, 10);
+
+  // Test
+  flightRecorderTrigger(flightRecorderTriggerParamWrite);
+  recordTicks(11, 1);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT8(flightRecorderStateFrozen, readState());
+  TEST_ASSERT_EQUAL_UINT16(11, readUint16(4));
+  TEST_ASSERT_EQUAL_UINT16(10, readUint16(6));
+}
+
+void testThatFramesAreReadOldestFirstAfterTheBufferWrapped() {
+  // Fixture
+  fixtureConfigure(0xff, 50);
+  fixtureArm();
+  // Frames are 4 + 2 + 4 bytes
+  const int capacity = FLIGHT_RECORDER_BUFFER_SIZE / 10;
+  recordTicks(1, capacity + 5);
+  flightRecorderTrigger(flightRecorderTriggerEmergencyStop);
+  recordTicks(capacity + 6, capacity);
+
+  // Test
+  uint8_t frame[10];
+  bool actual = flightRecorderMemRead(FLIGHT_RECORDER_HEADER_SIZE, sizeof(frame), frame);
+
+  // Assert
+  TEST_ASSERT_TRUE(actual);
+  TEST_ASSERT_EQUAL_UINT8(flightRecorderStateFrozen, readState());
+  TEST_ASSERT_EQUAL_UINT16(capacity, readUint16(4));
+
+  uint16_t triggerFrame = readUint16(6);
+  uint32_t lastTick = capacity + 6 + (capacity - 1) / 2;
+  uint32_t firstTick;
+  memcpy(&firstTick, frame, sizeof(firstTick));
+  TEST_ASSERT_EQUAL_UINT32(lastTick - capacity + 1, firstTick);
+  TEST_ASSERT_EQUAL_UINT32(capacity + 6, firstTick + triggerFrame);
+
+  uint16_t actualVar16;
+  float actualFloat;
+  memcpy(&actualVar16, &frame[4], sizeof(actualVar16));
+  memcpy(&actualFloat, &frame[6], sizeof(actualFloat));
+  TEST_ASSERT_EQUAL_UINT16(firstTick & 0xffff, actualVar16);
+  TEST_ASSERT_EQUAL_FLOAT(firstTick * 0.5f, actualFloat);
+}
+
+void testThatDisabledTriggersAreIgnored() {
+  // Fixture
+  fixtureConfigure(1 << flightRecorderTriggerTumble, 0);
+  fixtureArm();
+
+  // Test
+  flightRecorderTrigger(flightRecorderTriggerParamWrite);
+  recordTicks(1, 10);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT8(flightRecorderStateRecording, readState());
+}
+
+void testThatFreezeStopsRecordingRightAway() {
+  // Fixture
+  fixtureConfigure(0xff, 50);
+  fixtureArm();
+  recordTicks(1, 10);
+
+  // Test
+  flightRecorderFreeze(flightRecorderTriggerAssert);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT8(flightRecorderStateFrozen, readState());
+  TEST_ASSERT_EQUAL_UINT16(10, readUint16(4));
+  TEST_ASSERT_EQUAL_UINT16(9, readUint16(6));
+}
+
+// Helpers ////////////////////////////////////////////////
+
+static void fixtureConfigure(uint8_t triggerMask, uint8_t postPercent) {
+  uint8_t config[8] = {triggerMask, 1, postPercent, 2};
+  uint16_t ids[2] = {1, 2};
+  memcpy(&config[4], ids, sizeof(ids));
+  TEST_ASSERT_TRUE(flightRecorderMemWrite(CONFIG_OFFSET, sizeof(config), config));
+}
+
+static void fixtureArm() {
+  uint8_t recording = flightRecorderStateRecording;
+  TEST_ASSERT_TRUE(flightRecorderMemWrite(STATE_OFFSET, 1, &recording));
+}
+
+static uint8_t readState() {
+  uint8_t state;
+  TEST_ASSERT_TRUE(flightRecorderMemRead(STATE_OFFSET, 1, &state));
+  return state;
+}
+
+static uint16_t readUint16(uint32_t offset) {
+  uint16_t value;
+  TEST_ASSERT_TRUE(flightRecorderMemRead(offset, sizeof(value), (uint8_t*)&value));
+  return value;
+}
+
+static void recordTicks(uint32_t firstTick, int count) {
+  for (uint32_t tick = firstTick; tick < firstTick + count; tick++) {
+    var16 = tick;
+    varFloat = tick * 0.5f;
+    flightRecorderUpdate(tick);
+  }
+}
+
+static int logGetVarIdFromTocCallback(int tocId, int cmock_num_calls) {
+  return (tocId == 1 || tocId == 2) ? tocId + 10 : -1;
+}
+
+static void* logGetAddressCallback(int varid, int cmock_num_calls) {
+  return varid == 11 ? (void*)&var16 : (void*)&varFloat;
+}
+
+static int logGetTypeCallback(int varid, int cmock_num_calls) {
+  return varid == 11 ? LOG_UINT16 : LOG_FLOAT;
+}
+
+static uint8_t logVarSizeCallback(int type, int cmock_num_calls) {
+  return type == LOG_UINT16 ? 2 : 4;
+}
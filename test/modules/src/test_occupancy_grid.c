@@ -0,0 +1,163 @@
+// File under test occupancy_grid.c
+#include "occupancy_grid.h"
+
+#include <string.h>
+#include "unity.h"
+#include "range.h"
+
+static state_t state;
+
+static void fixtureSetPose(float x, float y, float yawDeg);
+
+void setUp(void) {
+  memset(&state, 0, sizeof(state));
+  state.position.z = 1.0f;
+  occupancyGridReset();
+}
+
+void tearDown(void) {
+  // Empty
+}
+
+void testThatHitMarksEndOfRayAsOccupied() {
+  // Fixture
+
+  // Test
+  occupancyGridInsertRay(0.05f, 0.05f, 0.0f, 1.0f, true);
+
+  // Assert
+  TEST_ASSERT_TRUE(occupancyGridIsOccupied(1.05f, 0.05f));
+  TEST_ASSERT_FALSE(occupancyGridIsOccupied(0.55f, 0.05f));
+}
+
+void testThatRayWithoutHitDoesNotMarkObstacle() {
+  // Fixture
+
+  // Test
+  occupancyGridInsertRay(0.05f, 0.05f, 0.0f, 1.0f, false);
+
+  // Assert
+  TEST_ASSERT_FALSE(occupancyGridIsOccupied(1.05f, 0.05f));
+}
+
+void testThatRaysPassingThroughAnObstacleClearIt() {
+  // Fixture
+  occupancyGridInsertRay(0.05f, 0.05f, 0.0f, 1.0f, true);
+
+  // Test
+  occupancyGridInsertRay(0.05f, 0.05f, 0.0f, 2.0f, true);
+  occupancyGridInsertRay(0.05f, 0.05f, 0.0f, 2.0f, true);
+
+  // Assert
+  TEST_ASSERT_FALSE(occupancyGridIsOccupied(1.05f, 0.05f));
+  TEST_ASSERT_TRUE(occupancyGridIsOccupied(2.05f, 0.05f));
+}
+
+void testThatNearestObstacleIsFoundAfterUpdate() {
+  // Fixture
+  fixtureSetPose(0.05f, 0.05f, 0.0f);
+  occupancyGridInsertRay(0.05f, 0.05f, 0.0f, 1.0f, true);
+  occupancyGridInsertRay(0.05f, 0.05f, (float)M_PI / 2.0f, 0.5f, true);
+
+  // Test
+  occupancyGridUpdate(&state);
+
+  // Assert
+  point_t obstacle;
+  float distance;
+  TEST_ASSERT_TRUE(occupancyGridGetNearestObstacle(&obstacle, &distance));
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 0.05f, obstacle.x);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 0.55f, obstacle.y);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 0.5f, distance);
+}
+
+void testThatObstaclesOutsideSearchRadiusAreIgnored() {
+  // Fixture
+  fixtureSetPose(0.05f, 0.05f, 0.0f);
+  occupancyGridInsertRay(0.05f, 0.05f, 0.0f, 2.5f, true);
+
+  // Test
+  occupancyGridUpdate(&state);
+
+  // Assert
+  point_t obstacle;
+  float distance;
+  TEST_ASSERT_FALSE(occupancyGridGetNearestObstacle(&obstacle, &distance));
+}
+
+void testThatNewRangesAreInsertedInTheWorldFrame() {
+  // Fixture
+  fixtureSetPose(0.05f, 0.05f, 90.0f);
+  rangeSet(rangeFront, 1.0f);
+
+  // Test
+  occupancyGridUpdate(&state);
+
+  // Assert
+  TEST_ASSERT_TRUE(occupancyGridIsOccupied(0.05f, 1.05f));
+}
+
+void testThatRangesAreOnlyInsertedOnce() {
+  // Fixture
+  fixtureSetPose(0.05f, 0.05f, 0.0f);
+  occupancyGridInsertRay(0.05f, 0.05f, 0.0f, 1.0f, true);
+  occupancyGridInsertRay(0.05f, 0.05f, 0.0f, 1.0f, true);
+  rangeSet(rangeFront, 2.0f);
+  occupancyGridUpdate(&state);
+
+  // Test
+  occupancyGridUpdate(&state);
+
+  // Assert
+  // One ray passing through a confirmed obstacle is not enough to clear it
+  TEST_ASSERT_TRUE(occupancyGridIsOccupied(1.05f, 0.05f));
+}
+
+void testThatFloorHitsFromTiltedSensorsAreNotMarked() {
+  // Fixture
+  fixtureSetPose(0.05f, 0.05f, 0.0f);
+  state.attitude.pitch = 15.0f;
+  rangeSet(rangeDown, 0.2f);
+  rangeSet(rangeFront, 1.0f);
+
+  // Test
+  occupancyGridUpdate(&state);
+
+  // Assert
+  TEST_ASSERT_FALSE(occupancyGridIsOccupied(1.05f, 0.05f));
+}
+
+void testThatGridFollowsTheCrazyflieAndForgetsOldCells() {
+  // Fixture
+  occupancyGridInsertRay(0.05f, 0.05f, (float)M_PI, 1.0f, true);
+  TEST_ASSERT_TRUE(occupancyGridIsOccupied(-0.95f, 0.05f));
+
+  // Test
+  fixtureSetPose(3.05f, 0.05f, 0.0f);
+  occupancyGridUpdate(&state);
+
+  // Assert
+  TEST_ASSERT_FALSE(occupancyGridIsOccupied(-0.95f, 0.05f));
+  // The cell that reused the memory of the old obstacle must be cleared
+  TEST_ASSERT_FALSE(occupancyGridIsOccupied(-0.95f + OCCUPANCY_GRID_SIZE * OCCUPANCY_GRID_RESOLUTION, 0.05f));
+}
+
+void testThatObstaclesAreKeptWhenTheGridMoves() {
+  // Fixture
+  occupancyGridInsertRay(0.05f, 0.05f, 0.0f, 1.0f, true);
+
+  // Test
+  fixtureSetPose(2.05f, 0.05f, 0.0f);
+  occupancyGridUpdate(&state);
+
+  // Assert
+  TEST_ASSERT_TRUE(occupancyGridIsOccupied(1.05f, 0.05f));
+}
+
+// Helpers ////////////////////////////////////////////////
+
+static void fixtureSetPose(float x, float y, float yawDeg) {
+  state.position.x = x;
+  state.position.y = y;
+  state.attitude.yaw = yawDeg;
+}
@@ -0,0 +1,300 @@
+// File under test toc_index.c
+#include "toc_index.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "unity.h"
+
+#define BENCHMARK_GROUPS 64
+#define BENCHMARK_VARIABLES_PER_GROUP 10
+#define BENCHMARK_TOC_SIZE (BENCHMARK_GROUPS * (BENCHMARK_VARIABLES_PER_GROUP + 2))
+
+#define GROUP_START 0x81
+#define GROUP_STOP 0x80
+
+typedef struct {
+  tocEntryKind_t kind;
+  uint8_t type;
+  const char* name;
+  uint8_t count;
+} entry_t;
+
+static const entry_t smallToc[] = {
+  {tocEntryGroupStart, GROUP_START, "stabilizer", 0},
+  {tocEntryVariable, 7, "roll", 0},
+  {tocEntryVariable, 7, "pitch", 0},
+  {tocEntryGroupStop, GROUP_STOP, "stop_stabilizer", 0},
+  {tocEntryGroupStart, GROUP_START, "acc", 0},
+  {tocEntryVariable, 5, "x", 0},
+  {tocEntryVariable, 5, "y", 0},
+  {tocEntryVariable, 5, "x", 0},
+  {tocEntryGroupStop, GROUP_STOP, "stop_acc", 0},
+  {tocEntryGroupStart, GROUP_START, "gyro", 0},
+  {tocEntryVariable, 1, "x", 3},
+  {tocEntryGroupStop, GROUP_STOP, "stop_gyro", 0},
+};
+
+static const uint8_t smallTocImage[] = {
+  TOC_IMAGE_VERSION, 6, 0, 0x78, 0x56, 0x34, 0x12,
+  GROUP_START, 's', 't', 'a', 'b', 'i', 'l', 'i', 'z', 'e', 'r', 0,
+  7, 'r', 'o', 'l', 'l', 0, 0,
+  7, 'p', 'i', 't', 'c', 'h', 0, 0,
+  GROUP_START, 'a', 'c', 'c', 0,
+  5, 'x', 0, 0,
+  5, 'y', 0, 0,
+  5, 'x', 0, 0,
+  GROUP_START, 'g', 'y', 'r', 'o', 0,
+  1, 'x', 0, 3,
+};
+
+#define CRC 0x12345678
+
+static const entry_t* toc;
+static entry_t benchmarkToc[BENCHMARK_TOC_SIZE];
+static char benchmarkNames[BENCHMARK_TOC_SIZE][16];
+
+static tocIndex_t tocIndex;
+static uint16_t storage[TOC_INDEX_STORAGE_SIZE(BENCHMARK_TOC_SIZE)];
+
+static void getEntry(int i, tocEntry_t* entry);
+static void fixtureBuildBenchmarkToc();
+static int linearFindId(int len, const char* group, const char* name);
+static uint64_t nowNs();
+
+void setUp(void) {
+  toc = smallToc;
+  tocIndexInit(&tocIndex, sizeof(smallToc) / sizeof(smallToc[0]), getEntry, storage);
+}
+
+void tearDown(void) {
+  // Empty
+}
+
+void testThatVariablesAreCounted() {
+  // Fixture
+
+  // Test
+  int actual = tocIndexCountVariables(sizeof(smallToc) / sizeof(smallToc[0]), getEntry);
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(6, actual);
+  TEST_ASSERT_EQUAL_INT(6, tocIndex.count);
+}
+
+void testThatIdsSkipGroupEntries() {
+  // Fixture
+
+  // Test
+  int actual = tocIndexGetEntry(&tocIndex, 2);
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(5, actual);
+}
+
+void testThatGroupOfVariableIsFound() {
+  // Fixture
+
+  // Test
+  int actual = tocIndexGetGroup(&tocIndex, 5);
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(9, actual);
+}
+
+void testThatIdsOutOfRangeAreRejected() {
+  // Fixture
+
+  // Test
+  // Assert
+  TEST_ASSERT_EQUAL_INT(-1, tocIndexGetEntry(&tocIndex, 6));
+  TEST_ASSERT_EQUAL_INT(-1, tocIndexGetEntry(&tocIndex, -1));
+  TEST_ASSERT_EQUAL_INT(-1, tocIndexGetGroup(&tocIndex, 6));
+}
+
+void testThatVariableIsFoundByName() {
+  // Fixture
+
+  // Test
+  int actual = tocIndexFindId(&tocIndex, "gyro", "x");
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(5, actual);
+}
+
+void testThatNameInOtherGroupIsNotFound() {
+  // Fixture
+
+  // Test
+  int actual = tocIndexFindId(&tocIndex, "stabilizer", "x");
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(-1, actual);
+}
+
+void testThatGroupIsNotFoundAsVariable() {
+  // Fixture
+
+  // Test
+  int actual = tocIndexFindId(&tocIndex, "acc", "acc");
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(-1, actual);
+}
+
+void testThatFirstOfDuplicatedNamesIsFound() {
+  // Fixture
+
+  // Test
+  int actual = tocIndexFindId(&tocIndex, "acc", "x");
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(2, actual);
+}
+
+void testThatAllVariablesOfALargeTocAreFound() {
+  // Fixture
+  fixtureBuildBenchmarkToc();
+
+  // Test
+  // Assert
+  for (int id = 0; id < tocIndex.count; id++) {
+    int entry = tocIndexGetEntry(&tocIndex, id);
+    const char* group = toc[tocIndexGetGroup(&tocIndex, id)].name;
+    TEST_ASSERT_EQUAL_INT(id, tocIndexFindId(&tocIndex, group, toc[entry].name));
+  }
+}
+
+void testThatImageSizeIsCalculated() {
+  // Fixture
+
+  // Test
+  uint32_t actual = tocIndexImageSize(&tocIndex);
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT32(sizeof(smallTocImage), actual);
+}
+
+void testThatImageIsReadInChunks() {
+  // Fixture
+  uint8_t actual[sizeof(smallTocImage)];
+
+  // Test
+  for (uint32_t offset = 0; offset < sizeof(smallTocImage); offset += 5) {
+    uint8_t length = sizeof(smallTocImage) - offset < 5 ? sizeof(smallTocImage) - offset : 5;
+    TEST_ASSERT_TRUE(tocIndexImageRead(&tocIndex, CRC, offset, length, &actual[offset]));
+  }
+
+  // Assert
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(smallTocImage, actual, sizeof(smallTocImage));
+}
+
+void testThatImageCanBeReadBackwards() {
+  // Fixture
+  uint8_t actual[4];
+  tocIndexImageRead(&tocIndex, CRC, 40, 4, actual);
+
+  // Test
+  bool result = tocIndexImageRead(&tocIndex, CRC, 20, 4, actual);
+
+  // Assert
+  TEST_ASSERT_TRUE(result);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(&smallTocImage[20], actual, 4);
+}
+
+void testThatImageReadOutsideImageFails() {
+  // Fixture
+  uint8_t actual[4];
+
+  // Test
+  bool result = tocIndexImageRead(&tocIndex, CRC, sizeof(smallTocImage) - 2, 4, actual);
+
+  // Assert
+  TEST_ASSERT_FALSE(result);
+}
+
+void testBenchmarkNameLookup() {
+  // Fixture
+  fixtureBuildBenchmarkToc();
+  int found = 0;
+
+  // Test
+  uint64_t start = nowNs();
+  for (int i = 0; i < BENCHMARK_TOC_SIZE; i++) {
+    if (toc[i].kind == tocEntryVariable) {
+      found += linearFindId(BENCHMARK_TOC_SIZE, benchmarkNames[i - i % (BENCHMARK_VARIABLES_PER_GROUP + 2)], toc[i].name) >= 0;
+    }
+  }
+  uint64_t linearDuration = nowNs() - start;
+
+  start = nowNs();
+  for (int i = 0; i < BENCHMARK_TOC_SIZE; i++) {
+    if (toc[i].kind == tocEntryVariable) {
+      found += tocIndexFindId(&tocIndex, benchmarkNames[i - i % (BENCHMARK_VARIABLES_PER_GROUP + 2)], toc[i].name) >= 0;
+    }
+  }
+  uint64_t indexedDuration = nowNs() - start;
+
+  // Assert
+  printf("toc name lookup of %d variables: linear %.1f ns, indexed %.1f ns per lookup\n", tocIndex.count,
+    (double)linearDuration / tocIndex.count, (double)indexedDuration / tocIndex.count);
+
+  TEST_ASSERT_EQUAL_INT(2 * tocIndex.count, found);
+}
+
+// Helpers ////////////////////////////////////////////////
+
+static void getEntry(int i, tocEntry_t* entry) {
+  entry->kind = toc[i].kind;
+  entry->type = toc[i].type;
+  entry->name = toc[i].name;
+  entry->count = toc[i].count;
+}
+
+static void fixtureBuildBenchmarkToc() {
+  int i = 0;
+  for (int group = 0; group < BENCHMARK_GROUPS; group++) {
+    sprintf(benchmarkNames[i], "group%d", group);
+    benchmarkToc[i] = (entry_t){tocEntryGroupStart, GROUP_START, benchmarkNames[i], 0};
+    i++;
+
+    for (int variable = 0; variable < BENCHMARK_VARIABLES_PER_GROUP; variable++) {
+      // Names in reverse order to make sure the toc is not sorted already
+      sprintf(benchmarkNames[i], "var%d", BENCHMARK_VARIABLES_PER_GROUP - variable);
+      benchmarkToc[i] = (entry_t){tocEntryVariable, 7, benchmarkNames[i], 0};
+      i++;
+    }
+
+    sprintf(benchmarkNames[i], "stop_group%d", group);
+    benchmarkToc[i] = (entry_t){tocEntryGroupStop, GROUP_STOP, benchmarkNames[i], 0};
+    i++;
+  }
+
+  toc = benchmarkToc;
+  tocIndexInit(&tocIndex, BENCHMARK_TOC_SIZE, getEntry, storage);
+}
+
+// The lookup that the index replaces
+static int linearFindId(int len, const char* group, const char* name) {
+  const char* currentGroup = "";
+  int id = 0;
+
+  for (int i = 0; i < len; i++) {
+    if (toc[i].kind == tocEntryGroupStart) {
+      currentGroup = toc[i].name;
+    } else if (toc[i].kind == tocEntryVariable) {
+      if (!strcmp(currentGroup, group) && !strcmp(toc[i].name, name)) {
+        return id;
+      }
+      id++;
+    }
+  }
+
+  return -1;
+}
+
+static uint64_t nowNs() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
@@ -4,3 +4,7 @@ uint32_t xTaskGetTickCount()
 {
   return 1;
 }
+
+void vTaskDelay(const uint32_t xTicksToDelay)
+{
+}
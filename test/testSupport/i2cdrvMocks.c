@@ -0,0 +1,69 @@
+#include "i2cdrvMocks.h"
+
+#include <string.h>
+
+#define I2C_SLAVE_ADDRESS_COUNT 128
+
+I2cDrv deckBus;
+I2cDrv sensorsBus;
+
+// Register pointer per slave, used for messages without internal address
+static uint8_t registerPointer[I2C_SLAVE_ADDRESS_COUNT];
+
+void i2cdrvInit(I2cDrv* i2c) {
+}
+
+void i2cdrvCreateMessage(I2cMessage *message,
+                      uint8_t  slaveAddress,
+                      I2cDirection  direction,
+                      uint32_t length,
+                      uint8_t  *buffer) {
+  message->slaveAddress = slaveAddress;
+  message->direction = direction;
+  message->isInternal16bit = false;
+  message->internalAddress = I2C_NO_INTERNAL_ADDRESS;
+  message->messageLength = length;
+  message->status = i2cAck;
+  message->buffer = buffer;
+}
+
+void i2cdrvCreateMessageIntAddr(I2cMessage *message,
+                             uint8_t  slaveAddress,
+                             bool IsInternal16,
+                             uint16_t intAddress,
+                             I2cDirection  direction,
+                             uint32_t length,
+                             uint8_t  *buffer) {
+  message->slaveAddress = slaveAddress;
+  message->direction = direction;
+  message->isInternal16bit = IsInternal16;
+  message->internalAddress = intAddress;
+  message->messageLength = length;
+  message->status = i2cAck;
+  message->buffer = buffer;
+}
+
+bool i2cdrvMessageTransfer(I2cDrv* i2c, I2cMessage* message) {
+  uint8_t slave = message->slaveAddress % I2C_SLAVE_ADDRESS_COUNT;
+  uint8_t* data = message->buffer;
+  uint16_t len = (uint16_t)message->messageLength;
+
+  if (message->internalAddress != I2C_NO_INTERNAL_ADDRESS) {
+    // The register files are 8 bit, 16 bit internal addresses use the low byte
+    registerPointer[slave] = (uint8_t)message->internalAddress;
+  } else if (message->direction == i2cWrite && len > 0) {
+    registerPointer[slave] = data[0];
+    data++;
+    len--;
+  }
+
+  bool result;
+  if (message->direction == i2cRead) {
+    result = sensorBusMockReadRegs(message->slaveAddress, registerPointer[slave], data, len);
+  } else {
+    result = sensorBusMockWriteRegs(message->slaveAddress, registerPointer[slave], data, len);
+  }
+
+  message->status = result ? i2cAck : i2cNack;
+  return result;
+}
@@ -0,0 +1,11 @@
+#ifndef __I2CDRV_MOCKS_H__
+#define __I2CDRV_MOCKS_H__
+
+// Implementation of the i2c_drv API on top of the host side sensor bus in
+// sensorBusMocks.h. Link it in to run drivers using i2cdev on the host, all
+// messages are served by the devices added to the mocked sensor bus.
+
+#include "i2c_drv.h"
+#include "sensorBusMocks.h"
+
+#endif // __I2CDRV_MOCKS_H__
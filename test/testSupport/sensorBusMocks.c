@@ -0,0 +1,204 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include "sensorBusMocks.h"
+
+#include <string.h>
+#include <time.h>
+#include "unity.h"
+
+typedef struct {
+  bool used;
+  bool failing;
+  uint8_t devAddr;
+  uint8_t regs[SENSOR_BUS_MOCK_REG_COUNT];
+  sensorBusMockModel_t model;
+  void* ctx;
+} sensorBusMockDevice_t;
+
+static sensorBusMockDevice_t devices[SENSOR_BUS_MOCK_MAX_DEVICES];
+static sensorBusMockStats_t stats;
+
+static const sensorBusMockTransaction_t* replayTransactions;
+static uint32_t replayCount;
+static uint32_t replayIndex;
+
+static sensorBusMockTransaction_t* recordBuffer;
+static uint32_t recordSize;
+static uint32_t recordIndex;
+
+
+static sensorBusMockDevice_t* findDevice(uint8_t devAddr) {
+  for (int i = 0; i < SENSOR_BUS_MOCK_MAX_DEVICES; i++) {
+    if (devices[i].used && devices[i].devAddr == devAddr) {
+      return &devices[i];
+    }
+  }
+
+  return 0;
+}
+
+static void record(sensorBusMockDirection_t direction, uint8_t devAddr, uint8_t regAddr, const uint8_t* data, uint16_t len) {
+  if (recordBuffer && recordIndex < recordSize) {
+    sensorBusMockTransaction_t* transaction = &recordBuffer[recordIndex++];
+    transaction->direction = direction;
+    transaction->devAddr = devAddr;
+    transaction->regAddr = regAddr;
+    transaction->len = len;
+    memset(transaction->data, 0, SENSOR_BUS_MOCK_MAX_DATA);
+    memcpy(transaction->data, data, len < SENSOR_BUS_MOCK_MAX_DATA ? len : SENSOR_BUS_MOCK_MAX_DATA);
+  }
+}
+
+static const sensorBusMockTransaction_t* nextReplayed(sensorBusMockDirection_t direction, uint8_t devAddr, uint8_t regAddr, uint16_t len) {
+  TEST_ASSERT_TRUE_MESSAGE(replayIndex < replayCount, "Unexpected bus transaction, replay exhausted");
+
+  const sensorBusMockTransaction_t* expected = &replayTransactions[replayIndex++];
+  TEST_ASSERT_EQUAL_INT_MESSAGE(expected->direction, direction, "Replayed transaction direction");
+  TEST_ASSERT_EQUAL_UINT8_MESSAGE(expected->devAddr, devAddr, "Replayed transaction device address");
+  TEST_ASSERT_EQUAL_UINT8_MESSAGE(expected->regAddr, regAddr, "Replayed transaction register address");
+  TEST_ASSERT_EQUAL_INT_MESSAGE(expected->len, len, "Replayed transaction length");
+
+  return expected;
+}
+
+void sensorBusMockReset() {
+  memset(devices, 0, sizeof(devices));
+  replayTransactions = 0;
+  replayCount = 0;
+  replayIndex = 0;
+  recordBuffer = 0;
+  recordSize = 0;
+  recordIndex = 0;
+  sensorBusMockClearStats();
+}
+
+uint8_t* sensorBusMockAddDevice(uint8_t devAddr, sensorBusMockModel_t model, void* ctx) {
+  TEST_ASSERT_NULL(findDevice(devAddr));
+
+  for (int i = 0; i < SENSOR_BUS_MOCK_MAX_DEVICES; i++) {
+    if (!devices[i].used) {
+      devices[i].used = true;
+      devices[i].devAddr = devAddr;
+      devices[i].model = model;
+      devices[i].ctx = ctx;
+      return devices[i].regs;
+    }
+  }
+
+  TEST_FAIL_MESSAGE("Too many devices on the mocked sensor bus");
+  return 0;
+}
+
+uint8_t* sensorBusMockGetRegisters(uint8_t devAddr) {
+  sensorBusMockDevice_t* device = findDevice(devAddr);
+  TEST_ASSERT_NOT_NULL(device);
+  return device->regs;
+}
+
+void sensorBusMockSetFailing(uint8_t devAddr, bool failing) {
+  sensorBusMockDevice_t* device = findDevice(devAddr);
+  TEST_ASSERT_NOT_NULL(device);
+  device->failing = failing;
+}
+
+void sensorBusMockReplay(const sensorBusMockTransaction_t* transactions, uint32_t count) {
+  replayTransactions = transactions;
+  replayCount = count;
+  replayIndex = 0;
+}
+
+uint32_t sensorBusMockReplayRemaining() {
+  return replayCount - replayIndex;
+}
+
+void sensorBusMockRecord(sensorBusMockTransaction_t* buffer, uint32_t size) {
+  recordBuffer = buffer;
+  recordSize = size;
+  recordIndex = 0;
+}
+
+uint32_t sensorBusMockRecordedCount() {
+  return recordIndex;
+}
+
+const sensorBusMockStats_t* sensorBusMockGetStats() {
+  return &stats;
+}
+
+void sensorBusMockClearStats() {
+  memset(&stats, 0, sizeof(stats));
+}
+
+bool sensorBusMockReadRegs(uint8_t devAddr, uint8_t regAddr, uint8_t* data, uint16_t len) {
+  stats.reads++;
+  stats.bytesRead += len;
+
+  if (replayTransactions) {
+    const sensorBusMockTransaction_t* replayed = nextReplayed(sensorBusMockRead, devAddr, regAddr, len);
+    TEST_ASSERT_TRUE(len <= SENSOR_BUS_MOCK_MAX_DATA);
+    memcpy(data, replayed->data, len);
+    record(sensorBusMockRead, devAddr, regAddr, data, len);
+    return true;
+  }
+
+  sensorBusMockDevice_t* device = findDevice(devAddr);
+  if (!device || device->failing) {
+    stats.errors++;
+    return false;
+  }
+
+  if (device->model) {
+    device->model(devAddr, regAddr, len, device->regs, device->ctx);
+  }
+
+  for (int i = 0; i < len; i++) {
+    data[i] = device->regs[(regAddr + i) % SENSOR_BUS_MOCK_REG_COUNT];
+  }
+
+  record(sensorBusMockRead, devAddr, regAddr, data, len);
+  return true;
+}
+
+bool sensorBusMockWriteRegs(uint8_t devAddr, uint8_t regAddr, const uint8_t* data, uint16_t len) {
+  stats.writes++;
+  stats.bytesWritten += len;
+  record(sensorBusMockWrite, devAddr, regAddr, data, len);
+
+  if (replayTransactions) {
+    const sensorBusMockTransaction_t* replayed = nextReplayed(sensorBusMockWrite, devAddr, regAddr, len);
+    TEST_ASSERT_TRUE(len <= SENSOR_BUS_MOCK_MAX_DATA);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(replayed->data, data, len);
+    return true;
+  }
+
+  sensorBusMockDevice_t* device = findDevice(devAddr);
+  if (!device || device->failing) {
+    stats.errors++;
+    return false;
+  }
+
+  for (int i = 0; i < len; i++) {
+    device->regs[(regAddr + i) % SENSOR_BUS_MOCK_REG_COUNT] = data[i];
+  }
+
+  return true;
+}
+
+int8_t sensorBusMockBstdrRead(uint8_t dev_id, uint8_t reg_addr, uint8_t *reg_data, uint16_t len) {
+  // Return values match BSTDR_OK and BSTDR_E_CON_ERROR
+  return sensorBusMockReadRegs(dev_id, reg_addr, reg_data, len) ? 0 : -4;
+}
+
+int8_t sensorBusMockBstdrWrite(uint8_t dev_id, uint8_t reg_addr, uint8_t *reg_data, uint16_t len) {
+  return sensorBusMockWriteRegs(dev_id, reg_addr, reg_data, len) ? 0 : -4;
+}
+
+void sensorBusMockBstdrDelay(uint32_t period) {
+  stats.delayMs += period;
+}
+
+uint64_t sensorBusMockNowNs() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
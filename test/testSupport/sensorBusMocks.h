@@ -0,0 +1,79 @@
+#ifndef __SENSOR_BUS_MOCKS_H__
+#define __SENSOR_BUS_MOCKS_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Host side sensor bus used to exercise sensor drivers without hardware.
+//
+// Each device on the bus is modelled as a 256 byte register file with auto
+// incrementing burst access, optionally backed by a model callback that can
+// update the registers (new samples, status bits, ...) before every read.
+// Alternatively a recorded list of transactions can be replayed, in which case
+// every bus access is checked against the recording and read data is taken
+// from it. All accesses are counted to make it possible to track the bus cost
+// of a driver call.
+
+#define SENSOR_BUS_MOCK_MAX_DEVICES 4
+#define SENSOR_BUS_MOCK_REG_COUNT 256
+#define SENSOR_BUS_MOCK_MAX_DATA 32
+
+typedef enum {
+  sensorBusMockRead,
+  sensorBusMockWrite,
+} sensorBusMockDirection_t;
+
+typedef struct {
+  sensorBusMockDirection_t direction;
+  uint8_t devAddr;
+  uint8_t regAddr;
+  uint16_t len;
+  uint8_t data[SENSOR_BUS_MOCK_MAX_DATA];
+} sensorBusMockTransaction_t;
+
+typedef struct {
+  uint32_t reads;
+  uint32_t writes;
+  uint32_t bytesRead;
+  uint32_t bytesWritten;
+  uint32_t delayMs;
+  uint32_t errors;
+} sensorBusMockStats_t;
+
+// Called before a read is served from the register file. regs is the register
+// file of the device and may be modified to emulate the behaviour of the device.
+typedef void (*sensorBusMockModel_t)(uint8_t devAddr, uint8_t regAddr, uint16_t len, uint8_t* regs, void* ctx);
+
+// Removes all devices, recordings and replays and clears the statistics
+void sensorBusMockReset();
+
+// Adds a device on the bus, model may be NULL for a plain register file
+uint8_t* sensorBusMockAddDevice(uint8_t devAddr, sensorBusMockModel_t model, void* ctx);
+uint8_t* sensorBusMockGetRegisters(uint8_t devAddr);
+
+// Make all accesses to a device fail, emulates a NACK or a missing device
+void sensorBusMockSetFailing(uint8_t devAddr, bool failing);
+
+// Replay a recorded sequence of transactions instead of using the register files
+void sensorBusMockReplay(const sensorBusMockTransaction_t* transactions, uint32_t count);
+uint32_t sensorBusMockReplayRemaining();
+
+// Record all transactions into the buffer, returns the number of transactions recorded so far
+void sensorBusMockRecord(sensorBusMockTransaction_t* buffer, uint32_t size);
+uint32_t sensorBusMockRecordedCount();
+
+const sensorBusMockStats_t* sensorBusMockGetStats();
+void sensorBusMockClearStats();
+
+bool sensorBusMockReadRegs(uint8_t devAddr, uint8_t regAddr, uint8_t* data, uint16_t len);
+bool sensorBusMockWriteRegs(uint8_t devAddr, uint8_t regAddr, const uint8_t* data, uint16_t len);
+
+// Backends matching the read/write/delay function pointers of the Bosch drivers (bstdr types)
+int8_t sensorBusMockBstdrRead(uint8_t dev_id, uint8_t reg_addr, uint8_t *reg_data, uint16_t len);
+int8_t sensorBusMockBstdrWrite(uint8_t dev_id, uint8_t reg_addr, uint8_t *reg_data, uint16_t len);
+void sensorBusMockBstdrDelay(uint32_t period);
+
+// Wall clock time in nano seconds, used to benchmark the CPU cost of driver calls on the host
+uint64_t sensorBusMockNowNs();
+
+#endif // __SENSOR_BUS_MOCKS_H__
@@ -0,0 +1,215 @@
+// File under test param_store.c
+#include "param_store.h"
+
+#include <errno.h>
+#include <string.h>
+#include "unity.h"
+#include "mock_eeprom.h"
+#include "mock_console.h"
+#include "crc.h"
+
+#define TYPE_FLOAT 0x06
+#define TYPE_UINT8 0x08
+#define HALF_SIZE ((EEPROM_SIZE - PARAM_STORE_START) / 2)
+
+static uint8_t eeprom[EEPROM_SIZE];
+// Bytes that can be written before the writes fail, -1 for no limit
+static int writeBudget;
+
+static bool eepromReadBufferCallback(uint8_t* buffer, uint16_t readAddr, uint16_t len, int cmock_num_calls);
+static bool eepromWriteBufferCallback(uint8_t* buffer, uint16_t writeAddr, uint16_t len, int cmock_num_calls);
+
+static void fixtureStoreFloat(uint32_t key, float value);
+static float readFloat(uint32_t key);
+
+void setUp(void) {
+  eepromReadBuffer_StubWithCallback(eepromReadBufferCallback);
+  eepromWriteBuffer_StubWithCallback(eepromWriteBufferCallback);
+  consolePrintf_IgnoreAndReturn(0);
+
+  memset(eeprom, 0xff, sizeof(eeprom));
+  writeBudget = -1;
+  paramStoreInit();
+}
+
+void tearDown(void) {
+  // Empty
+}
+
+void testThatNothingIsReadFromAnEmptyStore() {
+  // Fixture
+  float value;
+
+  // Test
+  bool actual = paramStoreGet(1, TYPE_FLOAT, &value, sizeof(value));
+
+  // Assert
+  TEST_ASSERT_FALSE(actual);
+}
+
+void testThatStoredValueIsReadAfterRestart() {
+  // Fixture
+  fixtureStoreFloat(1, 1.5f);
+
+  // Test
+  paramStoreInit();
+
+  // Assert
+  TEST_ASSERT_EQUAL_FLOAT(1.5f, readFloat(1));
+}
+
+void testThatTheLatestValueOfAKeyIsRead() {
+  // Fixture
+  fixtureStoreFloat(1, 1.5f);
+  fixtureStoreFloat(2, 2.5f);
+  fixtureStoreFloat(1, 3.5f);
+
+  // Test
+  paramStoreInit();
+
+  // Assert
+  TEST_ASSERT_EQUAL_FLOAT(3.5f, readFloat(1));
+  TEST_ASSERT_EQUAL_FLOAT(2.5f, readFloat(2));
+}
+
+void testThatClearedValueIsNotRead() {
+  // Fixture
+  fixtureStoreFloat(1, 1.5f);
+
+  // Test
+  TEST_ASSERT_EQUAL_INT(0, paramStoreClear(1));
+  paramStoreInit();
+
+  // Assert
+  float value;
+  TEST_ASSERT_FALSE(paramStoreGet(1, TYPE_FLOAT, &value, sizeof(value)));
+}
+
+void testThatValueOfAnotherTypeIsNotRead() {
+  // Fixture
+  uint8_t stored = 7;
+  TEST_ASSERT_EQUAL_INT(0, paramStoreSet(1, TYPE_UINT8, &stored, sizeof(stored)));
+
+  // Test
+  float value;
+  bool actual = paramStoreGet(1, TYPE_FLOAT, &value, sizeof(value));
+
+  // Assert
+  TEST_ASSERT_FALSE(actual);
+}
+
+void testThatValuesAreKeptWhenTheLogIsCompacted() {
+  // Fixture
+  fixtureStoreFloat(1, 1.5f);
+  fixtureStoreFloat(2, 2.5f);
+
+  // Test
+  // Several times the size of a half
+  for (int i = 0; i < 3 * HALF_SIZE / 14; i++) {
+    fixtureStoreFloat(3, i);
+  }
+  paramStoreInit();
+
+  // Assert
+  TEST_ASSERT_EQUAL_FLOAT(1.5f, readFloat(1));
+  TEST_ASSERT_EQUAL_FLOAT(2.5f, readFloat(2));
+  TEST_ASSERT_EQUAL_FLOAT(3 * HALF_SIZE / 14 - 1, readFloat(3));
+}
+
+void testThatAnInterruptedWriteKeepsTheOldValue() {
+  // Fixture
+  fixtureStoreFloat(1, 1.5f);
+  writeBudget = 8;
+
+  // Test
+  float value = 2.5f;
+  int actual = paramStoreSet(1, TYPE_FLOAT, &value, sizeof(value));
+  writeBudget = -1;
+  paramStoreInit();
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(EIO, actual);
+  TEST_ASSERT_EQUAL_FLOAT(1.5f, readFloat(1));
+}
+
+void testThatAnInterruptedCompactionKeepsTheOldValues() {
+  // Fixture
+  fixtureStoreFloat(1, 1.5f);
+  fixtureStoreFloat(2, 2.5f);
+
+  // Test
+  // Fill the half until the compaction, it is interrupted in the second record
+  int result = 0;
+  for (int i = 0; i < HALF_SIZE / 14 && result == 0; i++) {
+    writeBudget = 14 + 14 + 1;
+    float value = 10.0f;
+    result = paramStoreSet(3, TYPE_FLOAT, &value, sizeof(value));
+  }
+  writeBudget = -1;
+  paramStoreInit();
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(EIO, result);
+  TEST_ASSERT_EQUAL_FLOAT(1.5f, readFloat(1));
+  TEST_ASSERT_EQUAL_FLOAT(2.5f, readFloat(2));
+
+  // A new compaction must not pick up the records of the interrupted one
+  TEST_ASSERT_EQUAL_INT(0, paramStoreClear(1));
+  for (int i = 0; i < HALF_SIZE / 14; i++) {
+    fixtureStoreFloat(3, 20.0f);
+  }
+  paramStoreInit();
+  float value;
+  TEST_ASSERT_FALSE(paramStoreGet(1, TYPE_FLOAT, &value, sizeof(value)));
+  TEST_ASSERT_EQUAL_FLOAT(2.5f, readFloat(2));
+}
+
+void testThatKeysAreRefusedWhenTheStoreIsFull() {
+  // Fixture
+  for (int i = 0; i < PARAM_STORE_MAX_KEYS; i++) {
+    fixtureStoreFloat(i, i);
+  }
+
+  // Test
+  float value = 1.0f;
+  int actual = paramStoreSet(PARAM_STORE_MAX_KEYS, TYPE_FLOAT, &value, sizeof(value));
+
+  // Assert
+  TEST_ASSERT_EQUAL_INT(ENOMEM, actual);
+}
+
+// Helpers ////////////////////////////////////////////////
+
+static void fixtureStoreFloat(uint32_t key, float value) {
+  TEST_ASSERT_EQUAL_INT(0, paramStoreSet(key, TYPE_FLOAT, &value, sizeof(value)));
+}
+
+static float readFloat(uint32_t key) {
+  float value = 0.0f;
+  TEST_ASSERT_TRUE(paramStoreGet(key, TYPE_FLOAT, &value, sizeof(value)));
+  return value;
+}
+
+static bool eepromReadBufferCallback(uint8_t* buffer, uint16_t readAddr, uint16_t len, int cmock_num_calls) {
+  TEST_ASSERT_TRUE(readAddr >= PARAM_STORE_START);
+  TEST_ASSERT_TRUE(readAddr + len <= EEPROM_SIZE);
+  memcpy(buffer, &eeprom[readAddr], len);
+  return true;
+}
+
+static bool eepromWriteBufferCallback(uint8_t* buffer, uint16_t writeAddr, uint16_t len, int cmock_num_calls) {
+  TEST_ASSERT_TRUE(writeAddr >= PARAM_STORE_START);
+  TEST_ASSERT_TRUE(writeAddr + len <= EEPROM_SIZE);
+
+  for (int i = 0; i < len; i++) {
+    if (writeBudget == 0) {
+      return false;
+    }
+    if (writeBudget > 0) {
+      writeBudget--;
+    }
+    eeprom[writeAddr + i] = buffer[i];
+  }
+
+  return true;
+}
@@ -16,3 +16,8 @@ PROJ_OBJ += sensors_mpu9250_lps25h.o
 ESTIMATOR          ?= any
 CONTROLLER         ?= Any # one of Any, PID, Mellinger
 POWER_DISTRIBUTION ?= stock
+
+######### Log configuration ##########
+LOG_MAX_OPS    ?= 256
+LOG_MAX_BLOCKS ?= 16
+CFLAGS += -DLOG_MAX_OPS=$(LOG_MAX_OPS) -DLOG_MAX_BLOCKS=$(LOG_MAX_BLOCKS)